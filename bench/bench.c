@@ -0,0 +1,590 @@
+#define _GNU_SOURCE
+#include "../src/arena.h"
+#include "../src/concurrent_arena.h"
+#include "../src/profile.h"
+#include "../src/slab.h"
+#include "malloc_alloc.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define BENCH_OPS (1 << 20)
+#define BENCH_RESERVE ((size_t)1 << 34)
+#define CHURN_SLOTS 8192
+#define LIFO_DEPTH 64
+#define REALLOC_BUFFERS 64
+#define REALLOC_LIMIT (64 * 1024)
+#define BATCH_SIZE 64
+_Static_assert((BENCH_OPS / 8) % BATCH_SIZE == 0, "list_batch allocates its nodes in whole batches");
+#define SCALING_OPS (1 << 20)
+#define SCALING_SLOTS 1024
+#define SCALING_MAX_THREADS 32
+
+/**
+ * @brief Allocator under measure, reset drops every live allocation at once when the allocator supports it
+ */
+typedef struct {
+    const char *name;
+    Allocator allocator;
+    void (*reset)(void *context);
+    size_t (*alloc_batch)(size_t count, size_t size, void **out, void *context);
+    void (*free_batch)(size_t count, size_t size, void **ptrs, void *context);
+} Backend;
+
+/**
+ * @brief Latency of every timed operation of a run, in nanoseconds
+ */
+typedef struct {
+    uint64_t *samples;
+    size_t count;
+    size_t capacity;
+} Latencies;
+
+typedef struct Node {
+    struct Node *left;
+    struct Node *right;
+    uint64_t key;
+} Node;
+
+typedef size_t (*Workload)(Backend *b, Latencies *l, uint64_t *seed);
+
+/**
+ * @brief Thread of the scaling run, churning through its own slots
+ */
+typedef struct {
+    Allocator allocator;
+    uint64_t seed;
+    size_t ops;
+} ScalingWorker;
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline void record(Latencies *l, uint64_t ns) {
+    if (l->count < l->capacity) {
+        l->samples[l->count++] = ns;
+    }
+}
+
+// times a single allocator call, the clock overhead is paid the same by every backend
+#define timed(l, op)                                                                                                   \
+    do {                                                                                                               \
+        uint64_t start_ = now_ns();                                                                                    \
+        op;                                                                                                            \
+        record(l, now_ns() - start_);                                                                                  \
+    } while (0)
+
+static inline uint64_t next_random(uint64_t *seed) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return *seed;
+}
+
+/**
+ * @brief Draw an allocation size skewed towards small objects, as seen in typical heap profiles
+ */
+static size_t realistic_size(uint64_t *seed) {
+    uint64_t r = next_random(seed);
+    unsigned int bucket = r % 100;
+    r >>= 8;
+    if (bucket < 50) {
+        return 16 + r % 48;
+    }
+    if (bucket < 80) {
+        return 64 + r % 192;
+    }
+    if (bucket < 95) {
+        return 256 + r % 768;
+    }
+    return 1024 + r % (15 * 1024);
+}
+
+static size_t bench_bump(Backend *b, Latencies *l, uint64_t *seed) {
+    Allocator a = b->allocator;
+    size_t count = BENCH_OPS / 2;
+    void **ptrs = malloc(count * sizeof(void *));
+    size_t *sizes = malloc(count * sizeof(size_t));
+
+    for (size_t i = 0; i < count; i += 1) {
+        sizes[i] = 16 + next_random(seed) % 112;
+        timed(l, ptrs[i] = a.alloc(sizes[i], a.context));
+    }
+    if (b->reset) {
+        timed(l, b->reset(a.context));
+    } else {
+        for (size_t i = 0; i < count; i += 1) {
+            timed(l, a.free(sizes[i], ptrs[i], a.context));
+        }
+    }
+
+    free(ptrs);
+    free(sizes);
+    return b->reset ? count + 1 : 2 * count;
+}
+
+static size_t bench_lifo(Backend *b, Latencies *l, uint64_t *seed) {
+    Allocator a = b->allocator;
+    void *ptrs[LIFO_DEPTH];
+    size_t sizes[LIFO_DEPTH];
+    size_t ops = 0;
+
+    while (ops < BENCH_OPS) {
+        size_t depth = 1 + next_random(seed) % LIFO_DEPTH;
+        for (size_t i = 0; i < depth; i += 1) {
+            sizes[i] = realistic_size(seed);
+            timed(l, ptrs[i] = a.alloc(sizes[i], a.context));
+        }
+        for (size_t i = depth; i > 0; i -= 1) {
+            timed(l, a.free(sizes[i - 1], ptrs[i - 1], a.context));
+        }
+        ops += 2 * depth;
+    }
+    return ops;
+}
+
+static size_t bench_churn(Backend *b, Latencies *l, uint64_t *seed) {
+    Allocator a = b->allocator;
+    void **ptrs = calloc(CHURN_SLOTS, sizeof(void *));
+    size_t *sizes = calloc(CHURN_SLOTS, sizeof(size_t));
+
+    for (size_t op = 0; op < BENCH_OPS; op += 1) {
+        size_t i = next_random(seed) % CHURN_SLOTS;
+        if (ptrs[i]) {
+            timed(l, a.free(sizes[i], ptrs[i], a.context));
+            ptrs[i] = NULL;
+        } else {
+            sizes[i] = realistic_size(seed);
+            timed(l, ptrs[i] = a.alloc(sizes[i], a.context));
+            // touch the memory so that reuse patterns show up in the cache misses
+            memset(ptrs[i], (int)i, sizes[i] < 64 ? sizes[i] : 64);
+        }
+    }
+    for (size_t i = 0; i < CHURN_SLOTS; i += 1) {
+        if (ptrs[i]) {
+            a.free(sizes[i], ptrs[i], a.context);
+        }
+    }
+
+    free(ptrs);
+    free(sizes);
+    return BENCH_OPS;
+}
+
+static size_t bench_list(Backend *b, Latencies *l, uint64_t *seed) {
+    Allocator a = b->allocator;
+    size_t count = BENCH_OPS / 8;
+    size_t ops = 0;
+
+    for (int round = 0; round < 4; round += 1) {
+        Node *head = NULL;
+        for (size_t i = 0; i < count; i += 1) {
+            Node *node;
+            timed(l, node = make(Node, 1, a));
+            node->key = next_random(seed);
+            node->left = head;
+            head = node;
+        }
+        while (head) {
+            Node *next = head->left;
+            timed(l, release(Node, 1, head, a));
+            head = next;
+        }
+        ops += 2 * count;
+    }
+    return ops;
+}
+
+static size_t bench_list_batch(Backend *b, Latencies *l, uint64_t *seed) {
+    Allocator a = b->allocator;
+    size_t count = BENCH_OPS / 8;
+    size_t ops = 0;
+    void **nodes = malloc(count * sizeof(void *));
+
+    for (int round = 0; round < 4; round += 1) {
+        Node *head = NULL;
+        for (size_t i = 0; i < count; i += BATCH_SIZE) {
+            size_t done;
+            timed(l, done = b->alloc_batch(BATCH_SIZE, sizeof(Node), nodes + i, a.context));
+            // a short batch leaves the rest of the slots unset, the run fails instead of reading them
+            if (done < BATCH_SIZE) {
+                fprintf(stderr, "list_batch: batch of %d nodes cut to %zu\n", BATCH_SIZE, done);
+                exit(1);
+            }
+            for (size_t k = i; k < i + BATCH_SIZE; k += 1) {
+                Node *node = nodes[k];
+                node->key = next_random(seed);
+                node->left = head;
+                head = node;
+            }
+        }
+        for (size_t i = 0; head; i += 1) {
+            nodes[i] = head;
+            head = head->left;
+        }
+        for (size_t i = 0; i < count; i += BATCH_SIZE) {
+            timed(l, b->free_batch(BATCH_SIZE, sizeof(Node), nodes + i, a.context));
+        }
+        ops += 2 * count;
+    }
+
+    free(nodes);
+    return ops;
+}
+
+static Node *tree_insert(Node *root, Node *node) {
+    Node **link = &root;
+    while (*link) {
+        link = node->key < (*link)->key ? &(*link)->left : &(*link)->right;
+    }
+    *link = node;
+    return root;
+}
+
+static void tree_destroy(Node *root, Allocator a, Latencies *l) {
+    while (root) {
+        // rotate the left subtree up until the root has none, then free it and move right
+        if (root->left) {
+            Node *left = root->left;
+            root->left = left->right;
+            left->right = root;
+            root = left;
+        } else {
+            Node *right = root->right;
+            timed(l, release(Node, 1, root, a));
+            root = right;
+        }
+    }
+}
+
+static size_t bench_tree(Backend *b, Latencies *l, uint64_t *seed) {
+    Allocator a = b->allocator;
+    size_t count = BENCH_OPS / 16;
+    size_t ops = 0;
+
+    for (int round = 0; round < 4; round += 1) {
+        Node *root = NULL;
+        for (size_t i = 0; i < count; i += 1) {
+            Node *node;
+            timed(l, node = make(Node, 1, a));
+            node->key = next_random(seed);
+            node->left = node->right = NULL;
+            root = tree_insert(root, node);
+        }
+        tree_destroy(root, a, l);
+        ops += 2 * count;
+    }
+    return ops;
+}
+
+static size_t bench_realloc(Backend *b, Latencies *l, uint64_t *seed) {
+    Allocator a = b->allocator;
+    char *buffers[REALLOC_BUFFERS] = {0};
+    size_t sizes[REALLOC_BUFFERS] = {0};
+    size_t ops = 0;
+
+    while (ops < BENCH_OPS / 4) {
+        size_t i = next_random(seed) % REALLOC_BUFFERS;
+        if (sizes[i] >= REALLOC_LIMIT) {
+            timed(l, a.free(sizes[i], buffers[i], a.context));
+            buffers[i] = NULL;
+            sizes[i] = 0;
+        } else {
+            size_t grown = sizes[i] + 16 + next_random(seed) % 240;
+            if (buffers[i]) {
+                timed(l, buffers[i] = a.realloc(grown, sizes[i], buffers[i], a.context));
+            } else {
+                timed(l, buffers[i] = a.alloc(grown, a.context));
+            }
+            buffers[i][grown - 1] = (char)i;
+            sizes[i] = grown;
+        }
+        ops += 1;
+    }
+    for (size_t i = 0; i < REALLOC_BUFFERS; i += 1) {
+        if (buffers[i]) {
+            a.free(sizes[i], buffers[i], a.context);
+        }
+    }
+    return ops;
+}
+
+/**
+ * @brief malloc without the live memory accounting of malloc_alloc, whose shared counter threads would contend on
+ */
+static void *scaling_malloc(size_t size, void *context) {
+    (void)context;
+    return malloc(size);
+}
+
+static void scaling_free(size_t size, void *ptr, void *context) {
+    (void)size;
+    (void)context;
+    free(ptr);
+}
+
+static void *scaling_run(void *arg) {
+    ScalingWorker *w = (ScalingWorker *)arg;
+    Allocator a = w->allocator;
+    void *ptrs[SCALING_SLOTS] = {0};
+    size_t sizes[SCALING_SLOTS] = {0};
+
+    for (size_t op = 0; op < w->ops; op += 1) {
+        size_t i = next_random(&w->seed) % SCALING_SLOTS;
+        if (ptrs[i]) {
+            a.free(sizes[i], ptrs[i], a.context);
+            ptrs[i] = NULL;
+        } else {
+            sizes[i] = realistic_size(&w->seed);
+            ptrs[i] = a.alloc(sizes[i], a.context);
+            memset(ptrs[i], (int)i, sizes[i] < 64 ? sizes[i] : 64);
+        }
+    }
+    for (size_t i = 0; i < SCALING_SLOTS; i += 1) {
+        if (ptrs[i]) {
+            a.free(sizes[i], ptrs[i], a.context);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Run the churn of SCALING_OPS calls per thread on a number of threads in its own process, prints one JSON line
+ */
+static void bench_scaling(const char *backend_name, int threads) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid > 0) {
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            fprintf(stderr, "bench scaling/%s/%d failed\n", backend_name, threads);
+        }
+        return;
+    }
+
+    ConcurrentArena concurrent;
+    Allocator allocator = {scaling_malloc, scaling_free, 0, 0, 0, 0, 0};
+    if (!strcmp(backend_name, "concurrent_arena")) {
+        Arena arena = arena_init_virtual(BENCH_RESERVE, DEFAULT_COMMIT_CHUNK, DEFAULT_ALLIGNMENT, BestFit);
+        if (!arena.base || concurrent_arena_init(&concurrent, arena)) {
+            fprintf(stderr, "bench scaling/%s: cannot create the arena\n", backend_name);
+            exit(1);
+        }
+        allocator = concurrent_arena_alloc_init(&concurrent);
+    }
+
+    pthread_t ids[SCALING_MAX_THREADS];
+    ScalingWorker workers[SCALING_MAX_THREADS];
+    uint64_t start = now_ns();
+    for (int i = 0; i < threads; i += 1) {
+        workers[i] = (ScalingWorker){allocator, 0x9e3779b97f4a7c15u * (uint64_t)(i + 1), SCALING_OPS};
+        pthread_create(&ids[i], NULL, scaling_run, &workers[i]);
+    }
+    for (int i = 0; i < threads; i += 1) {
+        pthread_join(ids[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    size_t ops = (size_t)threads * SCALING_OPS;
+    printf("{\"workload\":\"scaling\",\"allocator\":\"%s\",\"threads\":%d,\"ops\":%zu,\"ops_per_sec\":%.0f}\n",
+           backend_name, threads, ops, (double)ops * 1e9 / (double)elapsed);
+    fflush(stdout);
+
+    if (!strcmp(backend_name, "concurrent_arena")) {
+        concurrent_arena_destroy(&concurrent);
+    }
+    _exit(0);
+}
+
+static int compare_u64(const void *x, const void *y) {
+    uint64_t a = *(const uint64_t *)x;
+    uint64_t b = *(const uint64_t *)y;
+    return (a > b) - (a < b);
+}
+
+static uint64_t percentile(Latencies *l, double p) {
+    if (!l->count) {
+        return 0;
+    }
+    size_t i = (size_t)(p * (double)(l->count - 1));
+    return l->samples[i];
+}
+
+/**
+ * @brief Open a counter of last level cache misses for the calling process, -1 if perf events are not available
+ */
+static int cache_misses_open(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static void cache_misses_start(int fd) {
+#ifdef __linux__
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)fd;
+#endif
+}
+
+static long long cache_misses_stop(int fd) {
+    long long misses = -1;
+#ifdef __linux__
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &misses, sizeof(misses)) != sizeof(misses)) {
+            misses = -1;
+        }
+        close(fd);
+    }
+#else
+    (void)fd;
+#endif
+    return misses;
+}
+
+/**
+ * @brief Run a workload in its own process so that the peak RSS belongs to that run only, prints one JSON line
+ */
+static void bench_run(const char *workload_name, Workload workload, const char *backend_name) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid > 0) {
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            fprintf(stderr, "bench %s/%s failed\n", workload_name, backend_name);
+        }
+        return;
+    }
+
+    Arena arena = {0};
+    SlabArena slab;
+    HeapProfiler profiler;
+    Backend backend;
+    if (!strcmp(backend_name, "malloc")) {
+        backend = (Backend){backend_name, malloc_alloc_init(), NULL, malloc_alloc_batch, malloc_free_batch};
+    } else {
+        AllocationStrategy strategy = strcmp(backend_name, "arena_first_fit") ? BestFit : FirstFit;
+        arena = arena_init_virtual(BENCH_RESERVE, DEFAULT_COMMIT_CHUNK, DEFAULT_ALLIGNMENT, strategy);
+        if (!arena.base) {
+            fprintf(stderr, "bench %s/%s: cannot reserve the arena\n", workload_name, backend_name);
+            exit(1);
+        }
+        backend = (Backend){backend_name, arena_alloc_init(&arena), arena_free_all, arena_alloc_batch,
+                            arena_free_batch};
+        if (!strcmp(backend_name, "slab")) {
+            slab = slab_arena_init(&arena);
+            backend = (Backend){backend_name, slab_arena_alloc_init(&slab), slab_arena_free_all, slab_arena_alloc_batch,
+                                slab_arena_free_batch};
+        }
+        // the cost of leaving the profiler on, the live samples cannot be dropped with the arena so there is no reset
+        if (!strcmp(backend_name, "arena_profiled")) {
+            if (profiler_init_arena(&profiler, &arena, PROFILE_DEFAULT_RATE)) {
+                fprintf(stderr, "bench %s/%s: cannot initialize the profiler\n", workload_name, backend_name);
+                exit(1);
+            }
+            backend.reset = NULL;
+        }
+    }
+
+    // no workload times more than BENCH_OPS calls, plus the last lifo round
+    Latencies latencies = {malloc((BENCH_OPS + 2 * LIFO_DEPTH) * sizeof(uint64_t)), 0, BENCH_OPS + 2 * LIFO_DEPTH};
+    // fault the samples in now, so that their page faults are not measured
+    memset(latencies.samples, 0, latencies.capacity * sizeof(uint64_t));
+    uint64_t seed = 0x9e3779b97f4a7c15u;
+
+    int fd = cache_misses_open();
+    cache_misses_start(fd);
+    uint64_t start = now_ns();
+    size_t ops = workload(&backend, &latencies, &seed);
+    uint64_t elapsed = now_ns() - start;
+    long long misses = cache_misses_stop(fd);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    qsort(latencies.samples, latencies.count, sizeof(uint64_t), compare_u64);
+
+    printf("{\"workload\":\"%s\",\"allocator\":\"%s\",\"ops\":%zu,\"ops_per_sec\":%.0f,\"p50_ns\":%llu,"
+           "\"p99_ns\":%llu,\"p999_ns\":%llu,\"peak_rss_kb\":%ld,\"cache_misses\":%lld}\n",
+           workload_name, backend_name, ops, (double)ops * 1e9 / (double)elapsed,
+           (unsigned long long)percentile(&latencies, 0.50), (unsigned long long)percentile(&latencies, 0.99),
+           (unsigned long long)percentile(&latencies, 0.999), usage.ru_maxrss, misses);
+    fflush(stdout);
+
+    if (arena.base) {
+        arena_destroy(&arena);
+    }
+    free(latencies.samples);
+    _exit(0);
+}
+
+int main(int argc, char **argv) {
+    struct {
+        const char *name;
+        Workload run;
+    } workloads[] = {
+        {"bump", bench_bump}, {"lifo", bench_lifo}, {"churn", bench_churn},
+        {"list", bench_list}, {"list_batch", bench_list_batch}, {"tree", bench_tree}, {"realloc", bench_realloc},
+    };
+    const char *backends[] = {"arena_best_fit", "arena_first_fit", "slab", "arena_profiled", "malloc"};
+
+    // an optional argument runs a single workload
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w += 1) {
+        if (argc > 1 && strcmp(argv[1], workloads[w].name)) {
+            continue;
+        }
+        for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b += 1) {
+            bench_run(workloads[w].name, workloads[w].run, backends[b]);
+        }
+    }
+
+    // throughput of the thread-safe allocators from one thread up to SCALING_MAX_THREADS
+    if (argc < 2 || !strcmp(argv[1], "scaling")) {
+        const char *scaling_backends[] = {"concurrent_arena", "malloc"};
+        for (int threads = 1; threads <= SCALING_MAX_THREADS; threads *= 2) {
+            for (size_t b = 0; b < sizeof(scaling_backends) / sizeof(scaling_backends[0]); b += 1) {
+                bench_scaling(scaling_backends[b], threads);
+            }
+        }
+    }
+
+    return 0;
+}
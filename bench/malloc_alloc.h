@@ -0,0 +1,64 @@
+#ifndef _MALLOC_ALLOC_H
+#define _MALLOC_ALLOC_H
+
+#include "../src/alloc.h"
+
+/**
+ * @brief Initialize an allocator forwarding to the C library, the baseline the arenas are measured against
+ */
+#define malloc_alloc_init()                                                                                            \
+    (Allocator) { malloc_alloc, malloc_free, malloc_realloc, malloc_calloc, malloc_allocated, 0, malloc_alloc_aligned }
+
+// Memory live through the malloc allocator, the C library does not account it
+static size_t malloc_live = 0;
+
+static inline void *malloc_alloc(size_t size, void *context) {
+    (void)context;
+    malloc_live += size;
+    return malloc(size);
+}
+
+static inline void malloc_free(size_t size, void *ptr, void *context) {
+    (void)context;
+    malloc_live -= size;
+    free(ptr);
+}
+
+static inline void *malloc_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    (void)context;
+    malloc_live += new_size - old_size;
+    return realloc(ptr, new_size);
+}
+
+static inline void *malloc_calloc(size_t count, size_t size, void *context) {
+    (void)context;
+    malloc_live += count * size;
+    return calloc(count, size);
+}
+
+static inline void *malloc_alloc_aligned(size_t size, size_t align, void *context) {
+    (void)context;
+    malloc_live += size;
+    return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+}
+
+static inline size_t malloc_allocated(void *context) {
+    (void)context;
+    return malloc_live;
+}
+
+static inline size_t malloc_alloc_batch(size_t count, size_t size, void **out, void *context) {
+    size_t done = 0;
+    while (done < count && (out[done] = malloc_alloc(size, context))) {
+        done++;
+    }
+    return done;
+}
+
+static inline void malloc_free_batch(size_t count, size_t size, void **ptrs, void *context) {
+    for (size_t i = 0; i < count; i++) {
+        malloc_free(size, ptrs[i], context);
+    }
+}
+
+#endif // _MALLOC_ALLOC_H
@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include "../src/arena.h"
+#include "../src/trace.h"
+#include "../src/utils.h"
+#include "malloc_alloc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Reservation of the virtual arena used when no capacity is given
+#define REPLAY_RESERVE ((size_t)1 << 36)
+
+/**
+ * @brief Allocation replayed for each id of the trace
+ *
+ * @param ptr memory allocated for the id, null if it is not live
+ * @param size size of the memory
+ */
+typedef struct {
+    void *ptr;
+    size_t size;
+} Live;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Make room in the live table for an id
+ */
+static int live_reserve(Live **live, size_t *capacity, uint64_t id) {
+    if (id < *capacity) {
+        return 1;
+    }
+    // the table is doubled past the id, its size in bytes must stay within a size_t
+    if (id >= SIZE_MAX / 2 / sizeof(Live)) {
+        return 0;
+    }
+    size_t grown = *capacity ? *capacity : 1024;
+    while (grown <= id) {
+        grown *= 2;
+    }
+    Live *table = realloc(*live, grown * sizeof(Live));
+    if (!table) {
+        return 0;
+    }
+    memset(table + *capacity, 0, (grown - *capacity) * sizeof(Live));
+    *live = table;
+    *capacity = grown;
+    return 1;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s <trace> [best_fit|first_fit|malloc] [align] [capacity]\n", name);
+    fprintf(stderr, "  align is a power of 2 and defaults to %zu, a capacity of 0 uses a virtual arena\n",
+            DEFAULT_ALLIGNMENT);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *allocator_name = argc > 2 ? argv[2] : "best_fit";
+    size_t align = argc > 3 ? strtoull(argv[3], NULL, 0) : DEFAULT_ALLIGNMENT;
+    size_t capacity = argc > 4 ? strtoull(argv[4], NULL, 0) : 0;
+    if (!is_power_of_two(align)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Arena arena = {0};
+    void *buffer = NULL;
+    Allocator allocator;
+    if (!strcmp(allocator_name, "malloc")) {
+        allocator = malloc_alloc_init();
+    } else if (!strcmp(allocator_name, "best_fit") || !strcmp(allocator_name, "first_fit")) {
+        AllocationStrategy strategy = strcmp(allocator_name, "first_fit") ? BestFit : FirstFit;
+        if (capacity) {
+            buffer = malloc(capacity);
+            arena = arena_init(buffer, capacity, align, strategy);
+        } else {
+            arena = arena_init_virtual(REPLAY_RESERVE, DEFAULT_COMMIT_CHUNK, align, strategy);
+        }
+        if (!arena.base) {
+            fprintf(stderr, "cannot create the arena\n");
+            return 1;
+        }
+        allocator = arena_alloc_init(&arena);
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+
+    TraceReader reader;
+    if (trace_reader_open(&reader, argv[1])) {
+        fprintf(stderr, "cannot read trace %s\n", argv[1]);
+        return 1;
+    }
+
+    Live *live = NULL;
+    size_t live_capacity = 0;
+    size_t events = 0;
+    size_t failed = 0;
+    size_t peak = 0;
+    size_t high_water = 0;
+    uint64_t elapsed = 0;
+
+    TraceEvent event;
+    int status;
+    while ((status = trace_reader_next(&reader, &event)) == 1) {
+        // ids are given in order, an event cannot name an allocation that was not made yet
+        if (event.id > events) {
+            fprintf(stderr, "trace %s has an unknown id at event %zu\n", argv[1], events);
+            return 1;
+        }
+        if (!live_reserve(&live, &live_capacity, event.id)) {
+            fprintf(stderr, "out of memory at event %zu\n", events);
+            return 1;
+        }
+        Live *l = &live[event.id];
+        uint64_t start = now_ns();
+
+        switch (event.op) {
+        case TraceAlloc:
+            l->ptr = allocator.alloc(event.size, allocator.context);
+            l->size = event.size;
+            break;
+        case TraceCalloc:
+            l->ptr = allocator.calloc(event.arg, event.size, allocator.context);
+            l->size = event.arg * event.size;
+            break;
+        case TraceAllocAligned:
+            l->ptr = allocator.alloc_aligned(event.size, event.arg, allocator.context);
+            l->size = event.size;
+            break;
+        case TraceRealloc:
+            if (l->ptr) {
+                void *ptr = allocator.realloc(event.size, l->size, l->ptr, allocator.context);
+                if (ptr) {
+                    l->ptr = ptr;
+                    l->size = event.size;
+                } else {
+                    failed++;
+                }
+            }
+            break;
+        case TraceFree:
+            if (l->ptr) {
+                allocator.free(l->size, l->ptr, allocator.context);
+                l->ptr = NULL;
+            }
+            break;
+        }
+
+        elapsed += now_ns() - start;
+        // an allocation that failed here stays failed for the rest of the trace
+        if (event.op != TraceFree && event.op != TraceRealloc && !l->ptr) {
+            failed++;
+        }
+        size_t in_use = allocated(allocator);
+        if (in_use > peak) {
+            peak = in_use;
+        }
+        // the statistics of the arena are not counted in this build, its high water mark is the peak offset
+        if (arena.offset > high_water) {
+            high_water = arena.offset;
+        }
+        events++;
+    }
+    trace_reader_close(&reader);
+
+    if (status < 0) {
+        fprintf(stderr, "trace %s is truncated after %zu events\n", argv[1], events);
+    }
+
+    ArenaStats stats = {0};
+    if (arena.base) {
+        arena_stats(&arena, &stats);
+    }
+    printf("{\"trace\":\"%s\",\"allocator\":\"%s\",\"align\":%zu,\"capacity\":%zu,\"events\":%zu,\"failed\":%zu,"
+           "\"ops_per_sec\":%.0f,\"peak_allocated\":%zu,\"high_water\":%zu,\"fragmentation\":%.4f}\n",
+           argv[1], allocator_name, align, capacity, events, failed,
+           elapsed ? (double)events * 1e9 / (double)elapsed : 0.0, peak, high_water, stats.fragmentation);
+
+    free(live);
+    if (arena.backing == VirtualBacking) {
+        arena_destroy(&arena);
+    }
+    free(buffer);
+    return status < 0;
+}
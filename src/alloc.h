@@ -33,11 +33,13 @@ typedef struct {
     /**
      * @brief Resizes the memory block.
      *
+     * Like realloc, a null pointer allocates a new block and a new size of zero frees the block and returns null.
+     *
      * @param new_size The new size of the memory block.
      * @param old_size The old size of the memory block.
      * @param ptr A pointer to the memory block to resize.
      * @param context A pointer to the effective allocator.
-     * @return A pointer to the resized memory block.
+     * @return A pointer to the resized memory block, null once freed.
      */
     void *(*realloc)(size_t new_size, size_t old_size, void *ptr, void *context);
     /**
@@ -61,6 +63,16 @@ typedef struct {
      * @brief A pointer to the effective allocator.
      */
     void *context;
+    /**
+     * @brief Allocates memory aligned to the given boundary, after context so that the members before it keep their
+     * positions.
+     *
+     * @param size The size of the memory block to allocate.
+     * @param align The alignment of the memory block, a power of 2.
+     * @param context A pointer to the effective allocator.
+     * @return A pointer to the allocated memory.
+     */
+    void *(*alloc_aligned)(size_t size, size_t align, void *context);
 } Allocator;
 
 /**
@@ -92,6 +104,16 @@ typedef struct {
  * @return A pointer to the allocated memory.
  */
 #define make_zeroed(T, n, a) ((T *)((a).calloc(n, sizeof(T), a.context)))
+/**
+ * @brief Allocates memory for n elements of type T aligned to the given boundary.
+ *
+ * @param T The type of the elements.
+ * @param n The number of elements to allocate.
+ * @param align The alignment of the memory block, a power of 2.
+ * @param a The Allocator structure.
+ * @return A pointer to the allocated memory.
+ */
+#define make_aligned(T, n, align, a) ((T *)((a).alloc_aligned(sizeof(T) * n, align, a.context)))
 /**
  * @brief Frees the memory block pointed to by p.
  *
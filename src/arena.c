@@ -1,9 +1,14 @@
+#define _GNU_SOURCE
+
 #include "arena.h"
 #include "utils.h"
 
-#include <malloc/_malloc.h>
+#include <fcntl.h>
 #include <memory.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #ifdef DEBUG
 #include <stdio.h>
@@ -12,32 +17,116 @@
 #define printf(...)
 #endif
 
+#ifdef ARENA_STATS
+#define arena_count(...) __VA_ARGS__
+#else
+#define arena_count(...)
+#endif
+
+// Number of exact bins, one every FREE_LIST_BIN_STEP bytes starting from sizeof(Block)
+#define FREE_LIST_EXACT_BINS (FREE_LIST_EXACT_LIMIT / FREE_LIST_BIN_STEP - 1)
+
+// Log2 of FREE_LIST_EXACT_LIMIT, the first power of two served by the geometric bins
+#define FREE_LIST_EXACT_LIMIT_LOG2 9
+
+// Number of blocks of a bin looked at when searching the free block following a reallocated one
+#define REALLOC_PROBE_DEPTH 8
+
+// Magic number at the start of arena files, "AREN" in little endian
+#define ARENA_FILE_MAGIC 0x4e455241u
+
+// Version of the arena file format, files of another version are not opened
+#define ARENA_FILE_VERSION 1
+
 /**
- * @brief Defines the available free list classes for reusing blocks
+ * @brief Header of a file-backed arena, stored in the ARENA_FILE_HEADER_SIZE bytes in front of the heap
+ *
+ * @param magic ARENA_FILE_MAGIC
+ * @param version ARENA_FILE_VERSION
+ * @param size size of the heap
+ * @param align alignment of the arena
+ * @param offset offset of the arena
+ * @param committed memory committed in the arena
+ * @param zeroed offset from which the heap was never written
+ * @param root offset of the root plus one, 0 if none
+ * @param base address of the heap when the free list was written, its links are relative to it
+ * @param strategy strategy of the arena
+ * @param free_list free list of the arena
+ * @param counters statistics counters of the arena
  */
-typedef enum {
-    Small = 0,  // 0 - 64 bytes
-    Medium = 1, // 64 - 512 bytes
-    Large = 2,  // 512 - 4096 bytes
-    Huge = 3,   // 4096 - the rest
-} BlockClass;
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    uint64_t align;
+    uint64_t offset;
+    uint64_t committed;
+    uint64_t zeroed;
+    uint64_t root;
+    uint64_t base;
+    uint32_t strategy;
+    FreeList free_list;
+    ArenaCounters counters;
+} ArenaFileHeader;
+
+_Static_assert(sizeof(ArenaFileHeader) <= ARENA_FILE_HEADER_SIZE, "arena file header does not fit");
 
 /**
  * @brief Allocate memory from the arena without locking or other high-level operations
  *
  * @param size size of the memory to allocate
+ * @param align alignment of the memory, at least the arena one
  * @param a arena to allocate from
  * @return void* pointer to the allocated memory
  */
-static void *arena_internal_alloc(size_t size, Arena *arena);
+static void *arena_internal_alloc(size_t size, size_t align, Arena *arena);
 /**
- * @brief Allocate memory from the arena with alignment specified by the arena
+ * @brief Allocate memory past the offset of the arena, the padding of over-aligned memory goes to the free list
  *
  * @param a arena to allocate from
  * @param size size of the memory to allocate
+ * @param align alignment of the memory, at least the arena one
  * @return void* pointer to the allocated memory
  */
-static void *arena_alloc_aligned(Arena *a, size_t size);
+static void *arena_alloc_aligned(Arena *a, size_t size, size_t align);
+/**
+ * @brief Check if a request missing the free list should merge the free blocks first
+ *
+ * The pass runs when the request does not fit past the offset, when it would commit new memory, or when enough blocks
+ * were recycled since the last pass, as many as it left and at least FREE_LIST_COALESCE_MIN. Its cost is then spread
+ * over the frees that made it necessary.
+ *
+ * @param a arena to check
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, at least the arena one
+ * @return int non-zero if the free blocks should be merged before bumping the offset
+ */
+static inline int arena_should_coalesce(Arena *a, size_t size, size_t align);
+/**
+ * @brief Set allocated memory to zero, skipping the part that was never handed out
+ *
+ * @param a arena the memory belongs to
+ * @param ptr pointer to the memory
+ * @param size size of the memory
+ * @param zeroed offset from which the memory was known to be zero before it was allocated
+ */
+static inline void arena_clear(Arena *a, void *ptr, size_t size, size_t zeroed);
+/**
+ * @brief Commit the memory of a virtual arena up to the requested offset
+ *
+ * @param a arena to commit
+ * @param end offset that must be readable and writable
+ * @return int non-zero if the memory is available
+ */
+static int arena_commit(Arena *a, size_t end);
+/**
+ * @brief Commit the memory of a virtual arena up to the requested offset, safe to call from many threads at once
+ *
+ * @param a arena to commit
+ * @param end offset that must be readable and writable
+ * @return int non-zero if the memory is available
+ */
+static int arena_atomic_commit(Arena *a, size_t end);
 /**
  * @brief Align a pointer to the specified alignment
  *
@@ -47,233 +136,1541 @@ static void *arena_alloc_aligned(Arena *a, size_t size);
  */
 static uintptr_t align_forward(uintptr_t ptr, size_t alignment);
 /**
- * @brief Recycle a block of memory back into the appropriate free list
+ * @brief Recycle a block of memory back into the appropriate free list bin
+ *
+ * @param a arena to recycle the block into
+ * @param ptr pointer to the block
+ * @param size size of the block
+ * @return size_t size of the block
+ */
+static size_t arena_recycle_alloc(Arena *a, void *ptr, size_t size);
+/**
+ * @brief Subtract freed memory from the committed memory of the arena and of the scopes it was allocated before
+ *
+ * @param a arena the memory belongs to
+ * @param ptr pointer to the freed memory
+ * @param size size of the freed memory
+ */
+static void arena_uncommit(Arena *a, void *ptr, size_t size);
+/**
+ * @brief Check if a block can grow in place, blocks from before the innermost scope never do
+ *
+ * @param a arena the block belongs to
+ * @param ptr pointer to the block
+ * @return int non-zero if the block can grow
+ */
+static inline int arena_can_grow(Arena *a, void *ptr);
+/**
+ * @brief Grow a block in place, on top of the arena or into the free block following it
+ *
+ * @param a arena the block belongs to
+ * @param ptr pointer to the block
+ * @param new_size new size of the block
+ * @param old_size old size of the block
+ * @return int non-zero if the block grew
+ */
+static int arena_grow_in_place(Arena *a, void *ptr, size_t new_size, size_t old_size);
+/**
+ * @brief Remove a given block from the free list, only the first blocks of its bin are looked at, the whole tree is
+ *
+ * @param a arena owning the free list
+ * @param block block to remove, may not be a free block at all
+ * @return int non-zero if the block was found and removed
+ */
+static int arena_free_list_unlink(Arena *a, Block *block);
+/**
+ * @brief Recycle a block allocated before the innermost scope into the free list of the scope owning it
  *
  * @param a arena to recycle the block into
  * @param ptr pointer to the block
  * @param size size of the block
  * @return size_t size of the block
  */
-static size_t arena_recycle_alloc(Arena *a, void *ptr, size_t size, BlockClass class);
+static size_t arena_temp_recycle_alloc(Arena *a, void *ptr, size_t size);
 /**
  * @brief Find the first block that fits the requested size in the free list
  *
  * @param a arena to search in
  * @param size size of the block
- * @return void* pointer to the block
+ * @return Block* pointer to the block, already removed from the free list
  */
-static void *arena_free_list_find_first_block(Arena *a, BlockClass class, size_t size);
+static Block *arena_free_list_find_first_block(Arena *a, size_t size);
 /**
  * @brief Find the best block that fits the requested size in the free list
  *
  * @param a arena to search in
  * @param size size of the block
- * @return void* pointer to the block
+ * @return Block* pointer to the block, already removed from the free list
+ */
+static Block *arena_free_list_find_best_block(Arena *a, size_t size);
+/**
+ * @brief Find a block that fits the requested size following the allocation strategy of the arena
+ *
+ * @param a arena to search in
+ * @param size size of the block
+ * @return Block* pointer to the block, already removed from the free list
+ */
+static Block *arena_free_list_find_block(Arena *a, size_t size);
+/**
+ * @brief Merge the adjacent blocks of the free list and give the block on top of the arena back to the bump pointer
+ *
+ * @param a arena to coalesce
+ * @return int non-zero if any block was merged or given back
+ */
+static int arena_free_list_coalesce(Arena *a);
+/**
+ * @brief Sort a list of blocks by address
+ *
+ * @param head first block of the list
+ * @return Block* first block of the sorted list
+ */
+static Block *block_list_sort(Block *head);
+/**
+ * @brief Merge two lists of blocks sorted by address
+ *
+ * @param left first sorted list
+ * @param right second sorted list
+ * @return Block* first block of the merged list
+ */
+static Block *block_list_merge(Block *left, Block *right);
+/**
+ * @brief Hand out a block taken from the free list, the unused head and tail go back to the free list
+ *
+ * @param a arena the block belongs to
+ * @param block block taken from the free list, big enough for the aligned memory
+ * @param size requested size
+ * @param align alignment of the memory, at least the arena one
+ * @return void* pointer to the memory
+ */
+static void *arena_free_list_take_block(Arena *a, Block *block, size_t size, size_t align);
+/**
+ * @brief Insert a block into the size-ordered tree
+ *
+ * @param root root of the tree, updated
+ * @param block block to insert, its size must be already set
+ */
+static void tree_insert(TreeBlock **root, TreeBlock *block);
+/**
+ * @brief Remove a block from the size-ordered tree
+ *
+ * @param root root of the tree, updated
+ * @param block block to remove
+ * @return int non-zero if the block was found in the tree
+ */
+static int tree_remove(TreeBlock **root, TreeBlock *block);
+/**
+ * @brief Remove the smallest block of the tree that fits the requested size
+ *
+ * @param root root of the tree, updated
+ * @param size size of the block
+ * @return Block* the removed block, null if none fits
+ */
+static Block *tree_take_best(TreeBlock **root, size_t size);
+/**
+ * @brief Move every block of a tree to the front of a list
+ *
+ * @param node root of the tree
+ * @param list list to prepend to
+ * @return Block* first block of the list
+ */
+static Block *tree_to_list(TreeBlock *node, Block *list);
+/**
+ * @brief Get the priority of a block in the tree, derived from its address
+ *
+ * @param block block of the tree
+ * @return uint64_t priority, the root has the highest one
+ */
+static inline uint64_t tree_priority(TreeBlock *block);
+/**
+ * @brief Compare two blocks by size then address
+ *
+ * @param a first block
+ * @param b second block
+ * @return int non-zero if a is ordered before b
+ */
+static inline int tree_before(TreeBlock *a, TreeBlock *b);
+/**
+ * @brief Add the blocks of a tree to the statistics of the free list
+ *
+ * @param node root of the tree
+ * @param stats statistics to update
+ */
+static void tree_stats(TreeBlock *node, ArenaStats *stats);
+/**
+ * @brief Push a block into the bin of its size, or into the tree for the biggest blocks
+ *
+ * @param list free list to push into
+ * @param block block to push, its size must be already set
+ */
+static inline void free_list_push(FreeList *list, Block *block);
+/**
+ * @brief Pop the first block of a non-empty bin
+ *
+ * @param list free list to pop from
+ * @param bin index of the bin
+ * @return Block* the popped block
+ */
+static inline Block *free_list_pop(FreeList *list, size_t bin);
+/**
+ * @brief Get the bin holding blocks of the given size
+ *
+ * @param size size of the block below FREE_LIST_TREE_LIMIT, sizes smaller than the first bin map to it
+ * @return size_t index of the bin
+ */
+static inline size_t get_bin_index(size_t size);
+/**
+ * @brief Get the smallest block size held by a bin
+ *
+ * @param bin index of the bin
+ * @return size_t lower bound of the bin
+ */
+static inline size_t get_bin_lower_bound(size_t bin);
+/**
+ * @brief Map memory backed by explicit huge pages
+ *
+ * @param size size of the memory, a multiple of the page size
+ * @param pages HugePages2M or HugePages1G
+ * @return void* mapped memory, null if the pages are not available
  */
-static void *arena_free_list_find_best_block(Arena *a, BlockClass class, size_t size);
+static void *map_huge_pages(size_t size, ArenaPages pages);
 /**
- * @brief Get the block class object
+ * @brief Map memory aligned to HUGE_PAGE_SIZE and advise the kernel to back it with transparent huge pages
+ *
+ * @param size size of the memory, a multiple of HUGE_PAGE_SIZE
+ * @param pages set to the pages obtained, TransparentHugePages or DefaultPages if the advice is not supported
+ * @return void* mapped memory, null if the memory could not be mapped
+ */
+static void *map_transparent_huge_pages(size_t size, ArenaPages *pages);
+/**
+ * @brief Get the block class of a size
  *
  * @param size size of the block
- * @return BlockClass most appropriate block class
+ * @return BlockClass class reported in the statistics
  */
 static inline BlockClass get_block_class(size_t size);
+/**
+ * @brief Add the blocks of a free list to the statistics
+ *
+ * @param list free list to measure
+ * @param stats statistics to update
+ */
+static void free_list_stats(FreeList *list, ArenaStats *stats);
+/**
+ * @brief Get the header of a file-backed arena
+ *
+ * @param a file-backed arena
+ * @return ArenaFileHeader* header mapped in front of the heap
+ */
+static inline ArenaFileHeader *arena_file_header(Arena *a);
+/**
+ * @brief Move the links of a free list after the heap moved, the tree is rebuilt for the new addresses
+ *
+ * @param list free list read back from the file
+ * @param delta distance the heap moved by, modulo the address space
+ */
+static void free_list_relocate(FreeList *list, uintptr_t delta);
+/**
+ * @brief Move the links of a tree after the heap moved and gather its blocks into a list
+ *
+ * @param node root of the tree, already moved
+ * @param delta distance the heap moved by, modulo the address space
+ * @param list list to prepend to
+ * @return Block* first block of the list
+ */
+static Block *tree_relocate(TreeBlock *node, uintptr_t delta, Block *list);
+/**
+ * @brief Write the pages of a shared arena that were copied since its snapshot back to its memory file
+ *
+ * @param a shared arena mapped privately over its memory file
+ * @return int 0 on success, -1 if the pages could not be written
+ */
+static int arena_write_back(Arena *a);
+/**
+ * @brief Give the whole pages of a range back to the system
+ *
+ * @param a arena the range belongs to
+ * @param start start of the range
+ * @param end end of the range
+ * @return size_t number of bytes given back
+ */
+static size_t arena_purge_range(Arena *a, uintptr_t start, uintptr_t end);
+/**
+ * @brief Get the size of the pages backing an arena
+ *
+ * @param a arena to check
+ * @return size_t size of the pages, the unit in which memory is given back
+ */
+static inline size_t arena_page_size(Arena *a);
+/**
+ * @brief Give the pages above the offset back to the system, the memory from there is known to be zero again
+ *
+ * @param a arena to purge
+ * @param keep bytes above the offset kept for the next allocations
+ * @return size_t number of bytes given back
+ */
+static size_t arena_purge_top(Arena *a, size_t keep);
+/**
+ * @brief Age the free blocks of a tree, purging the pages of the old enough ones
+ *
+ * @param a arena the tree belongs to
+ * @param node root of the tree
+ * @param age age from which the blocks are purged, 0 to purge them all
+ * @return size_t number of bytes given back
+ */
+static size_t tree_purge(Arena *a, TreeBlock *node, size_t age);
+/**
+ * @brief Account a big block freed, running a decay pass once enough of them were freed
+ *
+ * @param a arena the block was freed to
+ * @param size size of the block
+ */
+static inline void arena_purge_pending(Arena *a, size_t size);
+/**
+ * @brief Resize a block of the arena, in place when it shrinks or the memory past it is free
+ *
+ * @param a arena the block belongs to
+ * @param new_size new size of the block, not 0
+ * @param old_size old size of the block
+ * @param ptr block to resize, not null
+ * @return void* pointer to the resized block, null if the arena is full
+ */
+static void *arena_resize(Arena *a, size_t new_size, size_t old_size, void *ptr);
+/**
+ * @brief Count an allocation down with the sampler of the arena, if any
+ *
+ * Always inlined, even without optimizations, so that the sampler is called from the allocator entry point.
+ *
+ * @param a arena allocated from
+ * @param ptr allocated pointer, nothing is counted if null
+ * @param size size of the allocation
+ */
+static inline void arena_sample(Arena *a, void *ptr, size_t size) __attribute__((always_inline));
+/**
+ * @brief Tell the sampler of the arena that a block is freed, while it has live samples
+ *
+ * @param a arena the block is freed to
+ * @param ptr freed pointer
+ */
+static inline void arena_sample_forget(Arena *a, void *ptr) __attribute__((always_inline));
 
 Arena arena_init(void *buffer, size_t size, size_t align, AllocationStrategy strategy) {
     return (Arena){
         .base = buffer,
         .size = size,
+        .mapped = size,
+        .commit_chunk = 0,
         .align = align,
         .offset = 0,
         .committed = 0,
-        .free_list = {0},
+        .zeroed = size,
+        .free_list = {.bins = {0}, .map = 0, .tree = 0, .recycled = 0, .coalesced = 0},
         .strategy = strategy,
+        .backing = BufferBacking,
+        .pages = DefaultPages,
+        .purge_threshold = 0,
+        .purge_pending = 0,
+        .temp = 0,
+        .fd = -1,
+        .snapshot = 0,
     };
 }
 
-void *arena_alloc(size_t size, void *context) {
-    Arena *a = (Arena *)context;
-    void *ptr = arena_internal_alloc(size, a);
-    return ptr;
-}
+Arena arena_init_virtual(size_t reserve, size_t commit_chunk, size_t align, AllocationStrategy strategy) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    reserve = (size_t)align_forward(reserve, page);
+    commit_chunk = (size_t)align_forward(commit_chunk ? commit_chunk : DEFAULT_COMMIT_CHUNK, page);
 
-void *arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
-    if (new_size <= old_size) {
-        return ptr;
+    void *base = mmap(0, reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        return (Arena){0};
     }
 
-    Arena *a = (Arena *)context;
+    Arena a = arena_init(base, reserve, align, strategy);
+    a.mapped = 0;
+    a.commit_chunk = commit_chunk;
+    a.zeroed = 0;
+    a.backing = VirtualBacking;
+    return a;
+}
 
-    void *new_ptr = arena_internal_alloc(new_size, a);
-    if (new_ptr) {
-        memcpy(new_ptr, ptr, old_size);
+Arena arena_init_huge(size_t size, ArenaPages pages, size_t align, AllocationStrategy strategy) {
+    void *base = 0;
+    ArenaPages obtained = DefaultPages;
+
+    for (ArenaPages try = pages; !base && try >= HugePages2M; try--) {
+        size_t page = try == HugePages1G ? (size_t)1 << 30 : HUGE_PAGE_SIZE;
+        size_t rounded = (size_t)align_forward(size, page);
+        base = map_huge_pages(rounded, try);
+        if (base) {
+            size = rounded;
+            obtained = try;
+        }
     }
-    BlockClass class = get_block_class(old_size);
-    arena_recycle_alloc((Arena *)context, ptr, old_size, class);
-    return new_ptr;
-}
 
-void *arena_calloc(size_t count, size_t size, void *context) {
-    Arena *a = (Arena *)context;
+    if (!base && pages != DefaultPages) {
+        size = (size_t)align_forward(size, HUGE_PAGE_SIZE);
+        base = map_transparent_huge_pages(size, &obtained);
+    }
 
-    size_t total_size = count * size;
-    void *ptr = arena_internal_alloc(total_size, a);
-    if (ptr) {
-        memset(ptr, 0, total_size);
+    if (!base) {
+        size = (size_t)align_forward(size, (size_t)sysconf(_SC_PAGESIZE));
+        base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return (Arena){0};
+        }
     }
-    return ptr;
-}
 
-void arena_free(size_t size, void *ptr, void *context) {
-    BlockClass class = get_block_class(size);
-    arena_recycle_alloc((Arena *)context, ptr, size, class);
+    Arena a = arena_init(base, size, align, strategy);
+    a.zeroed = 0;
+    a.backing = MappedBacking;
+    a.pages = obtained;
+    return a;
 }
 
-void arena_free_all(void *context) {
-    Arena *a = (Arena *)context;
-    a->offset = 0;
-    a->committed = 0;
-    for (int i = 0; i < FREE_LIST_CLASSES; i++) {
-        a->free_list[i] = 0;
+Arena arena_init_file(const char *path, size_t size, size_t align, AllocationStrategy strategy) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return (Arena){0};
     }
-}
 
-static void *arena_alloc_aligned(Arena *a, size_t size) {
-    uintptr_t curr_ptr = (uintptr_t)a->base + (uintptr_t)a->offset;
-    uintptr_t offset = align_forward(curr_ptr, a->align);
-    offset -= (uintptr_t)a->base;
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return (Arena){0};
+    }
 
-    if (offset + size > a->size) {
-        return 0;
+    ArenaFileHeader header = {0};
+    int fresh = st.st_size == 0;
+    if (fresh) {
+        size = (size_t)align_forward(size, (size_t)sysconf(_SC_PAGESIZE));
+        if (!size || ftruncate(fd, (off_t)(ARENA_FILE_HEADER_SIZE + size))) {
+            close(fd);
+            return (Arena){0};
+        }
+    } else if (st.st_size < ARENA_FILE_HEADER_SIZE || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+               header.magic != ARENA_FILE_MAGIC || header.version != ARENA_FILE_VERSION ||
+               header.size > (uint64_t)st.st_size - ARENA_FILE_HEADER_SIZE) {
+        close(fd);
+        return (Arena){0};
+    } else {
+        size = (size_t)header.size;
     }
 
-    a->committed += size;
-    void *ptr = (uint8_t *)a->base + offset;
-    a->offset = offset + size;
+    // the heap goes back to its previous address when it is free, its free list needs no relocation then
+    void *hint = fresh ? 0 : (void *)(uintptr_t)(header.base - ARENA_FILE_HEADER_SIZE);
+    uint8_t *map = mmap(hint, ARENA_FILE_HEADER_SIZE + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return (Arena){0};
+    }
 
-    return ptr;
+    Arena a = arena_init(map + ARENA_FILE_HEADER_SIZE, size, align, strategy);
+    a.zeroed = 0;
+    a.backing = FileBacking;
+    if (!fresh) {
+        a.align = (size_t)header.align;
+        a.strategy = (AllocationStrategy)header.strategy;
+        a.offset = (size_t)header.offset;
+        a.committed = (size_t)header.committed;
+        a.zeroed = (size_t)header.zeroed;
+        a.free_list = header.free_list;
+        a.counters = header.counters;
+        if ((uintptr_t)a.base != header.base) {
+            free_list_relocate(&a.free_list, (uintptr_t)a.base - (uintptr_t)header.base);
+        }
+    }
+
+    // the header is written right away, a relocated free list no longer matches the one in the file
+    if (arena_sync(&a)) {
+        munmap(map, ARENA_FILE_HEADER_SIZE + size);
+        return (Arena){0};
+    }
+    return a;
 }
 
-static void *arena_internal_alloc(size_t size, Arena *a) {
-    if (!size) {
-        return 0;
+int arena_sync(Arena *a) {
+    if (a->backing != FileBacking || a->temp) {
+        return -1;
     }
 
-    void *ptr = 0;
-    BlockClass class = get_block_class(size);
+    ArenaFileHeader *header = arena_file_header(a);
+    *header = (ArenaFileHeader){
+        .magic = ARENA_FILE_MAGIC,
+        .version = ARENA_FILE_VERSION,
+        .size = a->size,
+        .align = a->align,
+        .offset = a->offset,
+        .committed = a->committed,
+        .zeroed = a->zeroed,
+        .root = header->root,
+        .base = (uintptr_t)a->base,
+        .strategy = (uint32_t)a->strategy,
+        .free_list = a->free_list,
+        .counters = a->counters,
+    };
 
-    if (a->strategy == FirstFit) {
-        ptr = arena_free_list_find_first_block(a, class, size);
-    } else if (a->strategy == BestFit) {
-        ptr = arena_free_list_find_best_block(a, class, size);
-    }
-    if (ptr) {
-        printf("------\n");
-        printf("Reusing ptr: %zu\n", (uintptr_t)ptr);
-        printf("Reusing size: %zu\n", size);
-        printf("------\n");
-        a->committed += size;
-        return ptr;
+    // nothing past the highest offset ever reached was written
+    size_t length = (size_t)align_forward(ARENA_FILE_HEADER_SIZE + a->zeroed, (size_t)sysconf(_SC_PAGESIZE));
+    if (length > ARENA_FILE_HEADER_SIZE + a->size) {
+        length = ARENA_FILE_HEADER_SIZE + a->size;
     }
-    void *alloc = arena_alloc_aligned(a, size);
+    return msync(header, length, MS_SYNC) ? -1 : 0;
+}
 
-    printf("------\n");
-    printf("Allocating ptr: %zu\n", (uintptr_t)alloc);
-    printf("Allocating size: %zu\n", size);
-    printf("------\n");
+void arena_set_root(Arena *a, void *root) {
+    arena_file_header(a)->root = root ? (uint64_t)arena_offset_of(a, root) + 1 : 0;
+}
 
-    return alloc;
+void *arena_get_root(Arena *a) {
+    uint64_t root = arena_file_header(a)->root;
+    return root ? arena_at(a, (size_t)(root - 1)) : 0;
 }
 
-static size_t arena_recycle_alloc(Arena *a, void *ptr, size_t size, BlockClass class) {
-    if (size < sizeof(Block)) {
-        return 0;
+Arena arena_init_shared(size_t size, size_t align, AllocationStrategy strategy) {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    size = (size_t)align_forward(size, (size_t)sysconf(_SC_PAGESIZE));
+    int fd = memfd_create("arena", MFD_CLOEXEC);
+    if (fd < 0) {
+        return (Arena){0};
     }
 
-    Block *block = (Block *)ptr;
-
-    uintptr_t cons_block = align_forward((uintptr_t)ptr + size, a->align);
-    size_t pad = (size_t)(cons_block - ((uintptr_t)ptr + size));
+    void *base = MAP_FAILED;
+    if (size && !ftruncate(fd, (off_t)size)) {
+        base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (base == MAP_FAILED) {
+        close(fd);
+        return (Arena){0};
+    }
 
-    block->size = size + pad;
-    block->next = a->free_list[class];
-    a->free_list[class] = block;
-    a->committed -= size;
+    Arena a = arena_init(base, size, align, strategy);
+    a.zeroed = 0;
+    a.backing = SharedBacking;
+    a.fd = fd;
+    return a;
+#else
+    (void)size;
+    (void)align;
+    (void)strategy;
+    return (Arena){0};
+#endif
+}
 
-    printf("------\n");
-    printf("Freeing ptr: %zu\n", (uintptr_t)ptr);
-    printf("Freeing cons_block: %zu\n", cons_block);
-    printf("Freeing size: %zu\n", size);
-    printf("Freeing pad: %zu\n", pad);
-    printf("freeing block of size %zu\n", block->size);
-    printf("------\n");
+int arena_snapshot(Arena *a, ArenaSnapshot *snapshot) {
+    if (a->backing != SharedBacking || a->snapshot) {
+        return -1;
+    }
 
-    return block->size;
-}
+    // the view is mapped first, so that a failure leaves the arena untouched
+    void *view = mmap(0, a->size, PROT_READ, MAP_SHARED, a->fd, 0);
+    if (view == MAP_FAILED) {
+        return -1;
+    }
 
-static void *arena_free_list_find_first_block(Arena *a, BlockClass class, size_t size) {
-    if (!a->free_list[class]) {
-        return 0;
+    // from now on the live heap writes to private copies of its pages, the memory file keeps the snapshot
+    if (mmap(a->base, a->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, a->fd, 0) == MAP_FAILED) {
+        munmap(view, a->size);
+        return -1;
     }
 
-    Block *prev = 0;
-    Block *curr = a->free_list[class];
+    *snapshot = (ArenaSnapshot){.arena = a, .base = view, .offset = a->offset, .committed = a->committed};
+    a->snapshot = snapshot;
+    return 0;
+}
 
-    while (curr) {
-        if (curr->size >= size) {
-            if (prev) {
-                prev->next = curr->next;
-            } else {
-                a->free_list[class] = curr->next;
-            }
-            return (void *)curr;
-        }
+int arena_snapshot_release(ArenaSnapshot *snapshot) {
+    Arena *a = snapshot->arena;
 
-        prev = curr;
-        curr = curr->next;
+    // the memory file takes the copied pages back and the heap is shared again, on failure the private copies are
+    // still the only ones holding the writes, they stay mapped along with the snapshot
+    if (arena_write_back(a) ||
+        mmap(a->base, a->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, a->fd, 0) == MAP_FAILED) {
+        return -1;
     }
 
+    munmap((void *)snapshot->base, a->size);
+    a->snapshot = 0;
+    *snapshot = (ArenaSnapshot){0};
     return 0;
 }
 
-static void *arena_free_list_find_best_block(Arena *a, BlockClass class, size_t size) {
-    if (!a->free_list[class]) {
-        return 0;
+void arena_destroy(Arena *a) {
+    // the memory file goes away with the arena, nothing is left for the snapshot to read
+    if (a->backing == SharedBacking && a->snapshot) {
+        munmap((void *)a->snapshot->base, a->size);
+        *a->snapshot = (ArenaSnapshot){0};
+    }
+    if ((a->backing == VirtualBacking || a->backing == MappedBacking || a->backing == SharedBacking) && a->base) {
+        munmap(a->base, a->size);
+    }
+    if (a->backing == SharedBacking && a->fd >= 0) {
+        close(a->fd);
+    }
+    if (a->backing == FileBacking && a->base) {
+        arena_sync(a);
+        munmap(arena_file_header(a), ARENA_FILE_HEADER_SIZE + a->size);
     }
+    *a = (Arena){0};
+}
 
-    Block *prev = 0;
-    Block *curr = a->free_list[class];
-    Block *best = 0;
+void *arena_alloc(size_t size, void *context) {
+    Arena *a = (Arena *)context;
+    void *ptr = arena_internal_alloc(size, a->align, a);
+    arena_sample(a, ptr, size);
+    return ptr;
+}
 
-    while (curr) {
-        if (curr->size >= size) {
-            if (!best || (best && curr->size < best->size)) {
-                best = curr;
-                if (best->size == size) {
-                    break;
-                }
+void *arena_alloc_aligned_ex(size_t size, size_t align, void *context) {
+    Arena *a = (Arena *)context;
+    if (!is_power_of_two(align)) {
+        return 0;
+    }
+    void *ptr = arena_internal_alloc(size, align > a->align ? align : a->align, a);
+    arena_sample(a, ptr, size);
+    return ptr;
+}
+
+void *arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    Arena *a = (Arena *)context;
+
+    if (!ptr) {
+        void *new_ptr = arena_internal_alloc(new_size, a->align, a);
+        arena_sample(a, new_ptr, new_size);
+        return new_ptr;
+    }
+
+    // like realloc, a size of zero frees the block and nothing is left to point to
+    if (!new_size) {
+        arena_sample_forget(a, ptr);
+        arena_recycle_alloc(a, ptr, old_size);
+        return 0;
+    }
+
+    void *new_ptr = arena_resize(a, new_size, old_size, ptr);
+    ArenaSampler *s = a->sampler;
+    if (new_ptr && s) {
+        // a sampled block keeps its sample, only the bytes it grows by count towards the next one
+        size_t grown = new_size > old_size ? new_size - old_size : 0;
+        if (!s->live && grown < s->until_sample) {
+            s->until_sample -= grown;
+        } else {
+            s->moved(s, ptr, new_ptr, old_size, new_size);
+        }
+    }
+    return new_ptr;
+}
+
+void *arena_calloc(size_t count, size_t size, void *context) {
+    Arena *a = (Arena *)context;
+
+    // the mark is read before the allocation moves it, memory past it was never handed out
+    size_t total_size = count * size;
+    size_t zeroed = a->zeroed;
+    void *ptr = arena_internal_alloc(total_size, a->align, a);
+    if (ptr) {
+        arena_clear(a, ptr, total_size, zeroed);
+    }
+    arena_sample(a, ptr, total_size);
+    return ptr;
+}
+
+void arena_free(size_t size, void *ptr, void *context) {
+    Arena *a = (Arena *)context;
+    arena_sample_forget(a, ptr);
+    arena_recycle_alloc(a, ptr, size);
+}
+
+static void *arena_resize(Arena *a, size_t new_size, size_t old_size, void *ptr) {
+    if (new_size <= old_size) {
+        // the tail past the aligned new end goes back to the arena, the padding is only accounted
+        uintptr_t end = (uintptr_t)ptr + old_size;
+        uintptr_t tail = align_forward((uintptr_t)ptr + new_size, a->align);
+        if (tail < end) {
+            arena_recycle_alloc(a, (void *)tail, (size_t)(end - tail));
+            end = tail;
+        }
+        arena_uncommit(a, ptr, (size_t)(end - ((uintptr_t)ptr + new_size)));
+        return ptr;
+    }
+
+    if (arena_grow_in_place(a, ptr, new_size, old_size)) {
+        return ptr;
+    }
+
+    void *new_ptr = arena_internal_alloc(new_size, a->align, a);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, old_size);
+        arena_recycle_alloc(a, ptr, old_size);
+    }
+    return new_ptr;
+}
+
+size_t arena_alloc_batch(size_t count, size_t size, void **out, void *context) {
+    Arena *a = (Arena *)context;
+    if (!size) {
+        return 0;
+    }
+
+    size_t stride = (size_t)align_forward(size, a->align);
+    size_t bin = stride < FREE_LIST_TREE_LIMIT ? get_bin_index(stride) : 0;
+    size_t done = 0;
+
+    // blocks of the exact size sit at the head of their bin, they are taken without searching
+    while (done < count && stride < FREE_LIST_TREE_LIMIT && a->free_list.bins[bin] &&
+           a->free_list.bins[bin]->size >= stride) {
+        out[done++] = arena_free_list_take_block(a, free_list_pop(&a->free_list, bin), size, a->align);
+        arena_count(a->counters.reuse_hits[get_block_class(size)]++);
+    }
+    a->committed += done * size;
+
+    size_t rest = count - done;
+    if (rest && rest - 1 <= (a->size - a->offset) / stride) {
+        uint8_t *ptr = arena_alloc_aligned(a, stride * (rest - 1) + size, a->align);
+        if (ptr) {
+            // the padding between the blocks is not accounted, each block is freed with its own size
+            a->committed -= (stride - size) * (rest - 1);
+            arena_count(a->counters.reuse_misses[get_block_class(size)] += rest);
+            arena_count(a->counters.padding += (stride - size) * (rest - 1));
+            for (; done < count; done++, ptr += stride) {
+                out[done] = ptr;
+            }
+        }
+    }
+
+    // without contiguous room left, the free list and coalescing may still serve the blocks one at a time
+    while (done < count && (out[done] = arena_internal_alloc(size, a->align, a))) {
+        done++;
+    }
+
+    // the whole batch is counted at once unless it uses up the interval
+    ArenaSampler *s = a->sampler;
+    if (s && done * size < s->until_sample) {
+        s->until_sample -= done * size;
+    } else if (s) {
+        for (size_t i = 0; i < done; i++) {
+            arena_sample(a, out[i], size);
+        }
+    }
+
+    return done;
+}
+
+void arena_free_batch(size_t count, size_t size, void **ptrs, void *context) {
+    Arena *a = (Arena *)context;
+    size_t stride = (size_t)align_forward(size, a->align);
+    if (a->sampler && a->sampler->live) {
+        for (size_t i = 0; i < count; i++) {
+            arena_sample_forget(a, ptrs[i]);
+        }
+    }
+
+    // blocks from before a scope go to their own scope, blocks too small to reuse are only accounted, and the
+    // biggest blocks are indexed one by one in the tree
+    if (a->temp || stride < sizeof(Block) || stride >= FREE_LIST_TREE_LIMIT) {
+        for (size_t i = 0; i < count; i++) {
+            if (ptrs[i]) {
+                arena_recycle_alloc(a, ptrs[i], size);
             }
         }
+        return;
+    }
+
+    Block *head = 0;
+    Block *tail = 0;
+    size_t chained = 0;
+
+    // batches are usually allocated in address order, walking them backwards lets every block on top rewind
+    for (size_t i = count; i > 0; i--) {
+        uintptr_t ptr = (uintptr_t)ptrs[i - 1];
+        if (!ptr) {
+            continue;
+        }
+
+        // the top block rewinds the offset, a misaligned block does not have the size of the others
+        if ((ptr & (a->align - 1)) || ptr + stride >= (uintptr_t)a->base + a->offset) {
+            arena_recycle_alloc(a, (void *)ptr, size);
+            continue;
+        }
+
+        Block *block = (Block *)ptr;
+        block->size = stride;
+        block->next = head;
+        head = block;
+        if (!tail) {
+            tail = block;
+        }
+        chained++;
+    }
+
+    if (head) {
+        size_t bin = get_bin_index(stride);
+        tail->next = a->free_list.bins[bin];
+        a->free_list.bins[bin] = head;
+        a->free_list.map |= (uint64_t)1 << bin;
+        a->free_list.recycled += chained;
+    }
+    a->committed -= chained * size;
+}
+
+void arena_free_all(void *context) {
+    Arena *a = (Arena *)context;
+    a->offset = 0;
+    a->committed = 0;
+    a->free_list = (FreeList){.bins = {0}, .map = 0, .tree = 0, .recycled = 0, .coalesced = 0};
+    a->temp = 0;
+}
+
+void arena_temp_begin(ArenaTemp *temp, Arena *a) {
+    temp->arena = a;
+    temp->offset = a->offset;
+    temp->committed = a->committed;
+    temp->free_list = a->free_list;
+    temp->prev = a->temp;
+
+    // the scope starts with an empty free list, so that blocks from before it never hold temporary data
+    a->free_list = (FreeList){.bins = {0}, .map = 0, .tree = 0, .recycled = 0, .coalesced = 0};
+    a->temp = temp;
+}
+
+void arena_temp_end(ArenaTemp *temp) {
+    Arena *a = temp->arena;
+    a->offset = temp->offset;
+    a->committed = temp->committed;
+    a->free_list = temp->free_list;
+    a->temp = temp->prev;
+}
+
+void arena_coalesce(void *context) { arena_free_list_coalesce((Arena *)context); }
+
+size_t arena_purge(Arena *a) {
+    if (a->backing == SharedBacking && a->snapshot) {
+        return 0;
+    }
+    a->purge_pending = 0;
+    return tree_purge(a, a->free_list.tree, 0) + arena_purge_top(a, 0);
+}
+
+void arena_set_purge_threshold(Arena *a, size_t threshold) {
+    a->purge_threshold = threshold;
+    a->purge_pending = 0;
+}
+
+void arena_set_sampler(Arena *a, ArenaSampler *sampler) { a->sampler = sampler; }
+
+void arena_stats(Arena *a, ArenaStats *stats) {
+    *stats = (ArenaStats){0};
+    stats->offset = a->offset;
+    stats->high_water = a->counters.high_water > a->offset ? a->counters.high_water : a->offset;
+    stats->committed = a->committed;
+    stats->available = a->size - a->offset;
+    stats->padding = a->counters.padding;
+    for (size_t class = 0; class < BLOCK_CLASSES; class++) {
+        stats->reuse_hits[class] = a->counters.reuse_hits[class];
+        stats->reuse_misses[class] = a->counters.reuse_misses[class];
+    }
+
+    // blocks kept aside by the scopes are free memory as well
+    free_list_stats(&a->free_list, stats);
+    for (ArenaTemp *temp = a->temp; temp; temp = temp->prev) {
+        free_list_stats(&temp->free_list, stats);
+    }
+
+    size_t free_bytes = stats->available;
+    for (size_t class = 0; class < BLOCK_CLASSES; class++) {
+        free_bytes += stats->free_bytes[class];
+    }
+    size_t largest = stats->largest_free_block > stats->available ? stats->largest_free_block : stats->available;
+    stats->fragmentation = free_bytes ? 1.0 - (double)largest / (double)free_bytes : 0.0;
+}
+
+void *arena_atomic_alloc(size_t size, void *context) {
+    return arena_atomic_alloc_aligned(size, ((Arena *)context)->align, context);
+}
+
+void *arena_atomic_alloc_aligned(size_t size, size_t align, void *context) {
+    Arena *a = (Arena *)context;
+    if (!size || !is_power_of_two(align)) {
+        return 0;
+    }
+
+    // reservations are multiples of the alignment and a failed one keeps its padding, so once the offset moved it stays
+    // aligned and no retry is needed, only an unaligned buffer is padded on its first reservations
+    size_t reserve = (size_t)align_forward(size, a->align);
+    size_t offset = __atomic_load_n(&a->offset, __ATOMIC_RELAXED);
+    size_t pad = (size_t)(align_forward((uintptr_t)a->base + offset, a->align) - ((uintptr_t)a->base + offset));
+
+    if (align <= a->align && !pad) {
+        offset = __atomic_fetch_add(&a->offset, reserve, __ATOMIC_RELAXED);
+    } else {
+        // the padding depends on the exact offset, it has to be reserved along with it
+        size_t alignment = align > a->align ? align : a->align;
+        do {
+            pad = (size_t)(align_forward((uintptr_t)a->base + offset, alignment) - ((uintptr_t)a->base + offset));
+            if (offset + pad + reserve > a->size) {
+                return 0;
+            }
+        } while (!__atomic_compare_exchange_n(&a->offset, &offset, offset + pad + reserve, 1, __ATOMIC_RELAXED,
+                                              __ATOMIC_RELAXED));
+    }
+    size_t end = offset + pad + reserve;
+
+    if (end > a->size || !arena_atomic_commit(a, end)) {
+        // give the reservation back unless another thread reserved past it in the meantime, the padding stays
+        __atomic_compare_exchange_n(&a->offset, &end, offset + pad, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    // memory handed out for the first time moves the mark up, a failed exchange reloads it
+    size_t zeroed = __atomic_load_n(&a->zeroed, __ATOMIC_RELAXED);
+    while (end > zeroed &&
+           !__atomic_compare_exchange_n(&a->zeroed, &zeroed, end, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        continue;
+    }
+
+    __atomic_fetch_add(&a->committed, size, __ATOMIC_RELAXED);
+    return (uint8_t *)a->base + offset + pad;
+}
+
+void *arena_atomic_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    if (!ptr) {
+        return arena_atomic_alloc(new_size, context);
+    }
+    // like realloc, a size of zero frees the block and nothing is left to point to
+    if (!new_size) {
+        arena_atomic_free(old_size, ptr, context);
+        return 0;
+    }
+
+    if (new_size <= old_size) {
+        arena_atomic_free(old_size - new_size, ptr, context);
+        return ptr;
+    }
+
+    void *new_ptr = arena_atomic_alloc(new_size, context);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, old_size);
+        arena_atomic_free(old_size, ptr, context);
+    }
+    return new_ptr;
+}
+
+void *arena_atomic_calloc(size_t count, size_t size, void *context) {
+    Arena *a = (Arena *)context;
+
+    // the reserved range is past the mark read here unless it was handed out before, then it is below it
+    size_t total_size = count * size;
+    size_t zeroed = __atomic_load_n(&a->zeroed, __ATOMIC_RELAXED);
+    void *ptr = arena_atomic_alloc(total_size, context);
+    if (ptr) {
+        arena_clear(a, ptr, total_size, zeroed);
+    }
+    return ptr;
+}
+
+void arena_atomic_free(size_t size, void *ptr, void *context) {
+    (void)ptr;
+    __atomic_fetch_sub(&((Arena *)context)->committed, size, __ATOMIC_RELAXED);
+}
+
+static void *arena_alloc_aligned(Arena *a, size_t size, size_t align) {
+    uintptr_t curr_ptr = (uintptr_t)a->base + (uintptr_t)a->offset;
+    uintptr_t offset = align_forward(curr_ptr, align);
+    offset -= (uintptr_t)a->base;
+
+    if (offset + size > a->size || !arena_commit(a, offset + size)) {
+        return 0;
+    }
+
+    uintptr_t pad = align_forward(curr_ptr, a->align);
+    if ((uintptr_t)a->base + offset - pad >= sizeof(Block)) {
+        Block *block = (Block *)pad;
+        block->size = (size_t)((uintptr_t)a->base + offset - pad);
+        free_list_push(&a->free_list, block);
+        a->free_list.recycled++;
+        arena_count(a->counters.padding -= block->size);
+    }
+    arena_count(a->counters.padding += (size_t)((uintptr_t)a->base + offset - curr_ptr));
+
+    a->committed += size;
+    void *ptr = (uint8_t *)a->base + offset;
+    a->offset = offset + size;
+    if (a->offset > a->zeroed) {
+        a->zeroed = a->offset;
+    }
+    arena_count(if (a->offset > a->counters.high_water) a->counters.high_water = a->offset);
+
+    return ptr;
+}
+
+static inline int arena_should_coalesce(Arena *a, size_t size, size_t align) {
+    uintptr_t curr_ptr = (uintptr_t)a->base + (uintptr_t)a->offset;
+    uintptr_t offset = align_forward(curr_ptr, align) - (uintptr_t)a->base;
+    if (offset + size > a->size || offset + size > a->mapped) {
+        return 1;
+    }
+    return a->free_list.recycled >= FREE_LIST_COALESCE_MIN && a->free_list.recycled >= a->free_list.coalesced;
+}
+
+static inline void arena_clear(Arena *a, void *ptr, size_t size, size_t zeroed) {
+    size_t offset = (size_t)((uintptr_t)ptr - (uintptr_t)a->base);
+    if (offset < zeroed) {
+        memset(ptr, 0, zeroed - offset < size ? zeroed - offset : size);
+    }
+}
+
+static int arena_commit(Arena *a, size_t end) {
+    if (end <= a->mapped) {
+        return 1;
+    }
+
+    size_t mapped = (end + a->commit_chunk - 1) / a->commit_chunk * a->commit_chunk;
+    if (mapped > a->size) {
+        mapped = a->size;
+    }
+
+    if (mprotect((uint8_t *)a->base + a->mapped, mapped - a->mapped, PROT_READ | PROT_WRITE)) {
+        return 0;
+    }
+
+    printf("------\n");
+    printf("Committing from: %zu\n", a->mapped);
+    printf("Committing to: %zu\n", mapped);
+    printf("------\n");
+
+    a->mapped = mapped;
+    return 1;
+}
+
+static int arena_atomic_commit(Arena *a, size_t end) {
+    size_t mapped = __atomic_load_n(&a->mapped, __ATOMIC_ACQUIRE);
+
+    while (end > mapped) {
+        size_t target = (end + a->commit_chunk - 1) / a->commit_chunk * a->commit_chunk;
+        if (target > a->size) {
+            target = a->size;
+        }
 
-        if (!curr->next) {
+        // committing a range twice is harmless, the threads racing here only agree on the new mapped size
+        if (mprotect((uint8_t *)a->base + mapped, target - mapped, PROT_READ | PROT_WRITE)) {
+            return 0;
+        }
+        if (__atomic_compare_exchange_n(&a->mapped, &mapped, target, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
             break;
         }
+    }
+
+    return 1;
+}
+
+static void *arena_internal_alloc(size_t size, size_t align, Arena *a) {
+    if (!size) {
+        return 0;
+    }
+
+    // free blocks are aligned to the arena, the worst padding up to the requested alignment must fit too
+    size_t search = size + (align - a->align);
+
+    void *ptr = 0;
+    Block *block = arena_free_list_find_block(a, search);
+
+    // merging the free blocks may make room for the request before the offset grows
+    if (!block && arena_should_coalesce(a, size, align) && arena_free_list_coalesce(a)) {
+        block = arena_free_list_find_block(a, search);
+    }
+    if (block) {
+        ptr = arena_free_list_take_block(a, block, size, align);
+        arena_count(a->counters.reuse_hits[get_block_class(size)]++);
+        printf("------\n");
+        printf("Reusing ptr: %zu\n", (uintptr_t)ptr);
+        printf("Reusing size: %zu\n", size);
+        printf("------\n");
+        a->committed += size;
+        return ptr;
+    }
+    void *alloc = arena_alloc_aligned(a, size, align);
+    arena_count(a->counters.reuse_misses[get_block_class(size)]++);
+
+    printf("------\n");
+    printf("Allocating ptr: %zu\n", (uintptr_t)alloc);
+    printf("Allocating size: %zu\n", size);
+    printf("------\n");
+
+    return alloc;
+}
+
+static size_t arena_recycle_alloc(Arena *a, void *ptr, size_t size) {
+    if (a->temp && (uintptr_t)ptr < (uintptr_t)a->base + a->temp->offset) {
+        return arena_temp_recycle_alloc(a, ptr, size);
+    }
+
+    // the block on top of the arena goes straight back to the bump pointer, its padding included
+    if (align_forward((uintptr_t)ptr + size, a->align) >= (uintptr_t)a->base + a->offset) {
+        a->offset = (size_t)((uintptr_t)ptr - (uintptr_t)a->base);
+        a->committed -= size;
+
+        printf("------\n");
+        printf("Rewinding ptr: %zu\n", (uintptr_t)ptr);
+        printf("Rewinding size: %zu\n", size);
+        printf("------\n");
+
+        if (size >= FREE_LIST_TREE_LIMIT) {
+            arena_purge_pending(a, size);
+        }
+        return size;
+    }
+
+    a->committed -= size;
+
+    // the padding up to the next aligned block belongs to this one, it may be what makes room for a Block
+    uintptr_t cons_block = align_forward((uintptr_t)ptr + size, a->align);
+    size_t pad = (size_t)(cons_block - ((uintptr_t)ptr + size));
+
+    if (size + pad < sizeof(Block)) {
+        return 0;
+    }
+
+    Block *block = (Block *)ptr;
+    block->size = size + pad;
+    free_list_push(&a->free_list, block);
+    a->free_list.recycled++;
+
+    printf("------\n");
+    printf("Freeing ptr: %zu\n", (uintptr_t)ptr);
+    printf("Freeing cons_block: %zu\n", cons_block);
+    printf("Freeing size: %zu\n", size);
+    printf("Freeing pad: %zu\n", pad);
+    printf("freeing block of size %zu\n", block->size);
+    printf("------\n");
 
+    if (block->size >= FREE_LIST_TREE_LIMIT) {
+        arena_purge_pending(a, block->size);
+    }
+    return block->size;
+}
+
+static void arena_uncommit(Arena *a, void *ptr, size_t size) {
+    a->committed -= size;
+    for (ArenaTemp *temp = a->temp; temp && (uintptr_t)ptr < (uintptr_t)a->base + temp->offset; temp = temp->prev) {
+        temp->committed -= size;
+    }
+}
+
+static inline int arena_can_grow(Arena *a, void *ptr) {
+    // a block from before the scope growing past the mark would survive the end of the scope
+    return !a->temp || (uintptr_t)ptr >= (uintptr_t)a->base + a->temp->offset;
+}
+
+static int arena_grow_in_place(Arena *a, void *ptr, size_t new_size, size_t old_size) {
+    if (!arena_can_grow(a, ptr)) {
+        return 0;
+    }
+
+    uintptr_t top = (uintptr_t)a->base + a->offset;
+    uintptr_t next = align_forward((uintptr_t)ptr + old_size, a->align);
+    size_t offset = (size_t)((uintptr_t)ptr - (uintptr_t)a->base) + new_size;
+
+    // the block on top of the arena just moves the offset
+    if (next >= top) {
+        if (offset > a->size || !arena_commit(a, offset)) {
+            return 0;
+        }
+        a->offset = offset;
+        a->committed += new_size - old_size;
+        if (a->offset > a->zeroed) {
+            a->zeroed = a->offset;
+        }
+        arena_count(if (a->offset > a->counters.high_water) a->counters.high_water = a->offset);
+        return 1;
+    }
+
+    // the size of a free block following this one tells in which bin it is, if it is free at all
+    Block *block = (Block *)next;
+    if (next + sizeof(Block) > top || block->size < sizeof(Block) || block->size > top - next ||
+        (uintptr_t)ptr + new_size > next + block->size || !arena_free_list_unlink(a, block)) {
+        return 0;
+    }
+
+    uintptr_t end = next + block->size;
+    uintptr_t used = align_forward((uintptr_t)ptr + new_size, a->align);
+    if (used + sizeof(Block) <= end) {
+        Block *rest = (Block *)used;
+        rest->size = (size_t)(end - used);
+        free_list_push(&a->free_list, rest);
+    }
+    a->committed += new_size - old_size;
+
+    printf("------\n");
+    printf("Growing ptr: %zu\n", (uintptr_t)ptr);
+    printf("Growing into block: %zu\n", next);
+    printf("Growing size: %zu\n", new_size);
+    printf("------\n");
+
+    return 1;
+}
+
+static int arena_free_list_unlink(Arena *a, Block *block) {
+    if (block->size >= FREE_LIST_TREE_LIMIT) {
+        return tree_remove(&a->free_list.tree, (TreeBlock *)block);
+    }
+
+    size_t bin = get_bin_index(block->size);
+    Block *prev = 0;
+    Block *curr = a->free_list.bins[bin];
+
+    for (int depth = 0; curr && depth < REALLOC_PROBE_DEPTH; depth++) {
+        if (curr == block) {
+            if (prev) {
+                prev->next = curr->next;
+            } else {
+                free_list_pop(&a->free_list, bin);
+            }
+            return 1;
+        }
         prev = curr;
         curr = curr->next;
     }
 
-    if (best) {
-        if (prev) {
-            prev->next = best->next;
+    return 0;
+}
+
+static size_t arena_temp_recycle_alloc(Arena *a, void *ptr, size_t size) {
+    // the outermost scope that began after the block was allocated restores it when it ends
+    ArenaTemp *owner = a->temp;
+    while (owner->prev && (uintptr_t)ptr < (uintptr_t)a->base + owner->prev->offset) {
+        owner = owner->prev;
+    }
+    arena_uncommit(a, ptr, size);
+
+    size_t block_size = (size_t)(align_forward((uintptr_t)ptr + size, a->align) - (uintptr_t)ptr);
+    if (block_size < sizeof(Block)) {
+        return 0;
+    }
+
+    Block *block = (Block *)ptr;
+    block->size = block_size;
+    free_list_push(&owner->free_list, block);
+    owner->free_list.recycled++;
+
+    printf("------\n");
+    printf("Freeing ptr from before the scope: %zu\n", (uintptr_t)ptr);
+    printf("Freeing size: %zu\n", size);
+    printf("------\n");
+
+    return block->size;
+}
+
+static Block *arena_free_list_find_block(Arena *a, size_t size) {
+    if (a->strategy == FirstFit) {
+        return arena_free_list_find_first_block(a, size);
+    } else if (a->strategy == BestFit) {
+        return arena_free_list_find_best_block(a, size);
+    }
+    return 0;
+}
+
+static Block *arena_free_list_find_first_block(Arena *a, size_t size) {
+    if (size >= FREE_LIST_TREE_LIMIT) {
+        return tree_take_best(&a->free_list.tree, size);
+    }
+
+    size_t bin = get_bin_index(size);
+    if (get_bin_lower_bound(bin) < size) {
+        bin++;
+    }
+
+    // every block from this bin on fits, the lowest non-empty bin is found with a single ctz
+    uint64_t candidates = bin < FREE_LIST_BINS ? a->free_list.map & (~(uint64_t)0 << bin) : 0;
+    if (!candidates) {
+        return tree_take_best(&a->free_list.tree, size);
+    }
+    return free_list_pop(&a->free_list, (size_t)__builtin_ctzll(candidates));
+}
+
+static Block *arena_free_list_find_best_block(Arena *a, size_t size) {
+    if (size >= FREE_LIST_TREE_LIMIT) {
+        return tree_take_best(&a->free_list.tree, size);
+    }
+
+    // the bin of the requested size may start with an exact fit, otherwise move to the bigger bins
+    size_t bin = get_bin_index(size);
+    Block *head = a->free_list.bins[bin];
+    if (head && head->size >= size) {
+        return free_list_pop(&a->free_list, bin);
+    }
+
+    uint64_t candidates = bin + 1 < FREE_LIST_BINS ? a->free_list.map & (~(uint64_t)0 << (bin + 1)) : 0;
+    if (!candidates) {
+        return tree_take_best(&a->free_list.tree, size);
+    }
+    return free_list_pop(&a->free_list, (size_t)__builtin_ctzll(candidates));
+}
+
+static int arena_free_list_coalesce(Arena *a) {
+    // without new free blocks the previous pass already merged everything
+    if ((!a->free_list.map && !a->free_list.tree) || !a->free_list.recycled) {
+        return 0;
+    }
+    a->free_list.recycled = 0;
+
+    // gather every bin and the tree into a single list, sorted by address the neighbours become adjacent
+    Block *list = tree_to_list(a->free_list.tree, 0);
+    a->free_list.tree = 0;
+    for (size_t bin = 0; bin < FREE_LIST_BINS; bin++) {
+        Block *tail = a->free_list.bins[bin];
+        if (!tail) {
+            continue;
+        }
+        while (tail->next) {
+            tail = tail->next;
+        }
+        tail->next = list;
+        list = a->free_list.bins[bin];
+        a->free_list.bins[bin] = 0;
+    }
+    a->free_list.map = 0;
+    list = block_list_sort(list);
+
+    int changed = 0;
+    a->free_list.coalesced = 0;
+    Block *curr = list;
+    while (curr) {
+        Block *next = curr->next;
+        if ((uint8_t *)curr + curr->size == (uint8_t *)next) {
+            curr->size += next->size;
+            curr->next = next->next;
+            changed = 1;
+            continue;
+        }
+
+        // nothing is allocated past the last free block when it reaches the offset
+        if (!next && (uintptr_t)curr + curr->size >= (uintptr_t)a->base + a->offset) {
+            a->offset = (size_t)((uintptr_t)curr - (uintptr_t)a->base);
+            printf("------\n");
+            printf("Rewinding ptr: %zu\n", (uintptr_t)curr);
+            printf("Rewinding size: %zu\n", curr->size);
+            printf("------\n");
+            return 1;
+        }
+
+        free_list_push(&a->free_list, curr);
+        a->free_list.coalesced++;
+        curr = next;
+    }
+
+    return changed;
+}
+
+static Block *block_list_sort(Block *head) {
+    if (!head || !head->next) {
+        return head;
+    }
+
+    Block *slow = head;
+    Block *fast = head->next;
+    while (fast && fast->next) {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+
+    Block *right = slow->next;
+    slow->next = 0;
+
+    return block_list_merge(block_list_sort(head), block_list_sort(right));
+}
+
+static Block *block_list_merge(Block *left, Block *right) {
+    Block head = {0};
+    Block *tail = &head;
+
+    while (left && right) {
+        if ((uintptr_t)left < (uintptr_t)right) {
+            tail->next = left;
+            left = left->next;
         } else {
-            a->free_list[class] = best->next;
+            tail->next = right;
+            right = right->next;
         }
+        tail = tail->next;
+    }
+    tail->next = left ? left : right;
 
-        return (void *)best;
+    return head.next;
+}
+
+static void *arena_free_list_take_block(Arena *a, Block *block, size_t size, size_t align) {
+    uintptr_t start = align_forward((uintptr_t)block, align);
+    if (start != (uintptr_t)block) {
+        Block *aligned = (Block *)start;
+        aligned->size = block->size - (size_t)(start - (uintptr_t)block);
+        if (start - (uintptr_t)block >= sizeof(Block)) {
+            block->size = (size_t)(start - (uintptr_t)block);
+            free_list_push(&a->free_list, block);
+        } else {
+            arena_count(a->counters.padding += (size_t)(start - (uintptr_t)block));
+        }
+        block = aligned;
     }
 
-    return 0;
+    size_t used = (size_t)(align_forward((uintptr_t)block + size, a->align) - (uintptr_t)block);
+
+    // split the block when its tail is big enough to be reused
+    if (block->size >= used + sizeof(Block)) {
+        Block *rest = (Block *)((uint8_t *)block + used);
+        rest->size = block->size - used;
+        free_list_push(&a->free_list, rest);
+        block->size = used;
+    }
+    arena_count(a->counters.padding += block->size - size);
+
+    return (void *)block;
+}
+
+static inline void free_list_push(FreeList *list, Block *block) {
+    if (block->size >= FREE_LIST_TREE_LIMIT) {
+        ((TreeBlock *)block)->age = 0;
+        tree_insert(&list->tree, (TreeBlock *)block);
+        return;
+    }
+
+    size_t bin = get_bin_index(block->size);
+    block->next = list->bins[bin];
+    list->bins[bin] = block;
+    list->map |= (uint64_t)1 << bin;
+}
+
+static inline Block *free_list_pop(FreeList *list, size_t bin) {
+    Block *block = list->bins[bin];
+    list->bins[bin] = block->next;
+    if (!block->next) {
+        list->map &= ~((uint64_t)1 << bin);
+    }
+    return block;
+}
+
+static void tree_insert(TreeBlock **root, TreeBlock *block) {
+    TreeBlock *node = *root;
+    if (!node) {
+        block->left = 0;
+        block->right = 0;
+        *root = block;
+        return;
+    }
+
+    // insert as a leaf, then rotate the block up while its priority is higher than its parent one
+    if (tree_before(block, node)) {
+        tree_insert(&node->left, block);
+        if (tree_priority(node->left) > tree_priority(node)) {
+            TreeBlock *left = node->left;
+            node->left = left->right;
+            left->right = node;
+            *root = left;
+        }
+    } else {
+        tree_insert(&node->right, block);
+        if (tree_priority(node->right) > tree_priority(node)) {
+            TreeBlock *right = node->right;
+            node->right = right->left;
+            right->left = node;
+            *root = right;
+        }
+    }
+}
+
+static int tree_remove(TreeBlock **root, TreeBlock *block) {
+    TreeBlock **link = root;
+    while (*link && *link != block) {
+        link = tree_before(block, *link) ? &(*link)->left : &(*link)->right;
+    }
+    if (!*link) {
+        return 0;
+    }
+
+    // merge both subtrees in place of the block, every left block is ordered before every right one
+    TreeBlock *left = block->left;
+    TreeBlock *right = block->right;
+    while (left && right) {
+        if (tree_priority(left) > tree_priority(right)) {
+            *link = left;
+            link = &left->right;
+            left = left->right;
+        } else {
+            *link = right;
+            link = &right->left;
+            right = right->left;
+        }
+    }
+    *link = left ? left : right;
+
+    return 1;
+}
+
+static Block *tree_take_best(TreeBlock **root, size_t size) {
+    TreeBlock *best = 0;
+    for (TreeBlock *node = *root; node;) {
+        if (node->block.size >= size) {
+            best = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+
+    if (!best) {
+        return 0;
+    }
+    tree_remove(root, best);
+    return &best->block;
+}
+
+static Block *tree_to_list(TreeBlock *node, Block *list) {
+    while (node) {
+        TreeBlock *left = node->left;
+        list = tree_to_list(node->right, list);
+        node->block.next = list;
+        list = &node->block;
+        node = left;
+    }
+    return list;
+}
+
+static inline uint64_t tree_priority(TreeBlock *block) {
+    return (uint64_t)(uintptr_t)block * 0x9e3779b97f4a7c15ull;
+}
+
+static void free_list_relocate(FreeList *list, uintptr_t delta) {
+    for (size_t bin = 0; bin < FREE_LIST_BINS; bin++) {
+        for (Block **link = &list->bins[bin]; *link; link = &(*link)->next) {
+            *link = (Block *)((uintptr_t)*link + delta);
+        }
+    }
+
+    // the priorities come from the addresses, the tree is balanced again by inserting its blocks anew
+    Block *huge = tree_relocate(list->tree ? (TreeBlock *)((uintptr_t)list->tree + delta) : 0, delta, 0);
+    list->tree = 0;
+    while (huge) {
+        Block *next = huge->next;
+        tree_insert(&list->tree, (TreeBlock *)huge);
+        huge = next;
+    }
+}
+
+static Block *tree_relocate(TreeBlock *node, uintptr_t delta, Block *list) {
+    while (node) {
+        TreeBlock *left = node->left ? (TreeBlock *)((uintptr_t)node->left + delta) : 0;
+        TreeBlock *right = node->right ? (TreeBlock *)((uintptr_t)node->right + delta) : 0;
+        list = tree_relocate(left, delta, list);
+        node->block.next = list;
+        list = &node->block;
+        node = right;
+    }
+    return list;
+}
+
+static inline int tree_before(TreeBlock *a, TreeBlock *b) {
+    if (a->block.size != b->block.size) {
+        return a->block.size < b->block.size;
+    }
+    return (uintptr_t)a < (uintptr_t)b;
 }
 
 static uintptr_t align_forward(uintptr_t ptr, size_t alignment) {
@@ -294,6 +1691,31 @@ static uintptr_t align_forward(uintptr_t ptr, size_t alignment) {
     return p;
 }
 
+static inline size_t get_bin_index(size_t size) {
+    if (size < FREE_LIST_BIN_STEP) {
+        return 0;
+    }
+    if (size < FREE_LIST_EXACT_LIMIT) {
+        return size / FREE_LIST_BIN_STEP - 1;
+    }
+
+    size_t log2 = (size_t)(63 - __builtin_clzll((unsigned long long)size));
+    size_t sub = (size >> (log2 - FREE_LIST_SUB_BINS_LOG2)) & ((1 << FREE_LIST_SUB_BINS_LOG2) - 1);
+    return FREE_LIST_EXACT_BINS + ((log2 - FREE_LIST_EXACT_LIMIT_LOG2) << FREE_LIST_SUB_BINS_LOG2) + sub;
+}
+
+static inline size_t get_bin_lower_bound(size_t bin) {
+    if (bin < FREE_LIST_EXACT_BINS) {
+        return (bin + 1) * FREE_LIST_BIN_STEP;
+    }
+
+    size_t geometric = bin - FREE_LIST_EXACT_BINS;
+    size_t log2 = FREE_LIST_EXACT_LIMIT_LOG2 + (geometric >> FREE_LIST_SUB_BINS_LOG2);
+    size_t sub = geometric & ((1 << FREE_LIST_SUB_BINS_LOG2) - 1);
+
+    return ((size_t)1 << log2) + (sub << (log2 - FREE_LIST_SUB_BINS_LOG2));
+}
+
 static inline BlockClass get_block_class(size_t size) {
     if (size <= 64) {
         return Small;
@@ -305,3 +1727,207 @@ static inline BlockClass get_block_class(size_t size) {
         return Huge;
     }
 }
+
+static void free_list_stats(FreeList *list, ArenaStats *stats) {
+    tree_stats(list->tree, stats);
+
+    for (size_t bin = 0; bin < FREE_LIST_BINS; bin++) {
+        for (Block *block = list->bins[bin]; block; block = block->next) {
+            BlockClass class = get_block_class(block->size);
+            stats->free_blocks[class]++;
+            stats->free_bytes[class] += block->size;
+            if (block->size > stats->largest_free_block) {
+                stats->largest_free_block = block->size;
+            }
+        }
+    }
+}
+
+static int arena_write_back(Arena *a) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t end = (size_t)align_forward(a->zeroed, page);
+    if (end > a->size) {
+        end = a->size;
+    }
+
+    // the page map tells the private copies apart from the pages still read from the memory file
+    int pagemap = open("/proc/self/pagemap", O_RDONLY);
+    uint64_t entries[512];
+    for (size_t offset = 0; offset < end;) {
+        size_t count = (end - offset) / page < 512 ? (end - offset) / page : 512;
+        uintptr_t first = ((uintptr_t)a->base + offset) / page;
+        size_t length = count * sizeof(uint64_t);
+        int known =
+            pagemap >= 0 && pread(pagemap, entries, length, (off_t)(first * sizeof(uint64_t))) == (ssize_t)length;
+
+        for (size_t i = 0; i < count; i++, offset += page) {
+            // present or swapped, and not a file page, is a page copied on write
+            uint64_t entry = known ? entries[i] : (uint64_t)3 << 62;
+            if (!(entry >> 62) || (entry >> 61 & 1)) {
+                continue;
+            }
+            if (pwrite(a->fd, (uint8_t *)a->base + offset, page, (off_t)offset) != (ssize_t)page) {
+                if (pagemap >= 0) {
+                    close(pagemap);
+                }
+                return -1;
+            }
+        }
+    }
+
+    if (pagemap >= 0) {
+        close(pagemap);
+    }
+    return 0;
+}
+
+static inline size_t arena_page_size(Arena *a) {
+    // explicit huge pages can only be given back whole
+    return a->pages == HugePages1G   ? (size_t)1 << 30
+           : a->pages == HugePages2M ? HUGE_PAGE_SIZE
+                                     : (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static size_t arena_purge_range(Arena *a, uintptr_t start, uintptr_t end) {
+    size_t page = arena_page_size(a);
+    start = align_forward(start, page);
+    end &= ~(uintptr_t)(page - 1);
+    if (start >= end) {
+        return 0;
+    }
+
+    // memory files keep their pages until a hole is punched in them
+    int advice = MADV_DONTNEED;
+#ifdef MADV_REMOVE
+    if (a->backing == FileBacking || a->backing == SharedBacking) {
+        advice = MADV_REMOVE;
+    }
+#endif
+    return madvise((void *)start, (size_t)(end - start), advice) ? 0 : (size_t)(end - start);
+}
+
+static size_t arena_purge_top(Arena *a, size_t keep) {
+    // the page holding the mark is dirty up to it and zero after it, it goes as a whole
+    size_t page = arena_page_size(a);
+    uintptr_t start = align_forward((uintptr_t)a->base + a->offset + keep, page);
+    uintptr_t end = align_forward((uintptr_t)a->base + (a->zeroed < a->size ? a->zeroed : a->size), page);
+    if (end > (uintptr_t)a->base + a->size) {
+        end = (uintptr_t)a->base + a->size;
+    }
+    if (start >= end) {
+        return 0;
+    }
+
+    size_t purged = arena_purge_range(a, start, end);
+#ifdef __linux__
+    // released private pages read back as zero, the mark moves down to them unless the buffer is the caller's
+    if (purged && a->backing != BufferBacking && start + purged == end) {
+        a->zeroed = (size_t)(start - (uintptr_t)a->base);
+    }
+#endif
+    return purged;
+}
+
+static size_t tree_purge(Arena *a, TreeBlock *node, size_t age) {
+    size_t purged = 0;
+    while (node) {
+        purged += tree_purge(a, node->left, age);
+        if (node->age != TREE_BLOCK_PURGED && node->age++ >= age) {
+            // the header of the block stays, the pages after it go
+            purged += arena_purge_range(a, (uintptr_t)node + sizeof(TreeBlock), (uintptr_t)node + node->block.size);
+            node->age = TREE_BLOCK_PURGED;
+        }
+        node = node->right;
+    }
+    return purged;
+}
+
+static inline void arena_purge_pending(Arena *a, size_t size) {
+    a->purge_pending += size;
+    if (a->purge_threshold && a->purge_pending >= a->purge_threshold &&
+        !(a->backing == SharedBacking && a->snapshot)) {
+        a->purge_pending = 0;
+        tree_purge(a, a->free_list.tree, 1);
+        arena_purge_top(a, a->purge_threshold);
+    }
+}
+
+static inline void arena_sample(Arena *a, void *ptr, size_t size) {
+    ArenaSampler *s = a->sampler;
+    if (!s || !ptr) {
+        return;
+    }
+    if (size < s->until_sample) {
+        s->until_sample -= size;
+        return;
+    }
+    s->sample(s, ptr, size);
+}
+
+static inline void arena_sample_forget(Arena *a, void *ptr) {
+    if (a->sampler && a->sampler->live && ptr) {
+        a->sampler->forget(a->sampler, ptr);
+    }
+}
+
+static inline ArenaFileHeader *arena_file_header(Arena *a) {
+    return (ArenaFileHeader *)((uint8_t *)a->base - ARENA_FILE_HEADER_SIZE);
+}
+
+static void tree_stats(TreeBlock *node, ArenaStats *stats) {
+    while (node) {
+        // the tree starts at FREE_LIST_TREE_LIMIT, a block of exactly that size is still a large one
+        BlockClass class = get_block_class(node->block.size);
+        stats->free_blocks[class]++;
+        stats->free_bytes[class] += node->block.size;
+        if (node->block.size > stats->largest_free_block) {
+            stats->largest_free_block = node->block.size;
+        }
+        tree_stats(node->left, stats);
+        node = node->right;
+    }
+}
+
+static void *map_huge_pages(size_t size, ArenaPages pages) {
+#ifdef MAP_HUGETLB
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+    flags |= (pages == HugePages1G ? 30 : 21) << MAP_HUGE_SHIFT;
+#else
+    // without a page size flag only the default huge page size of the system can be asked for
+    if (pages != HugePages2M) {
+        return 0;
+    }
+#endif
+    void *base = mmap(0, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    return base == MAP_FAILED ? 0 : base;
+#else
+    (void)size;
+    (void)pages;
+    return 0;
+#endif
+}
+
+static void *map_transparent_huge_pages(size_t size, ArenaPages *pages) {
+    // over-map by a huge page and trim both ends, so that the kernel can back every 2 MiB of it with a huge page
+    uint8_t *raw = mmap(0, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return 0;
+    }
+
+    uint8_t *base = (uint8_t *)align_forward((uintptr_t)raw, HUGE_PAGE_SIZE);
+    if (base > raw) {
+        munmap(raw, (size_t)(base - raw));
+    }
+    if (base + size < raw + size + HUGE_PAGE_SIZE) {
+        munmap(base + size, (size_t)(raw + size + HUGE_PAGE_SIZE - (base + size)));
+    }
+
+    *pages = DefaultPages;
+#ifdef MADV_HUGEPAGE
+    if (!madvise(base, size, MADV_HUGEPAGE)) {
+        *pages = TransparentHugePages;
+    }
+#endif
+    return base;
+}
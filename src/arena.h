@@ -3,9 +3,37 @@
 
 #include "alloc.h"
 #include <pthread.h>
+#include <stdint.h>
 
-// Number of free list classes
-#define FREE_LIST_CLASSES 4
+// Number of segregated free list bins, the ones below FREE_LIST_TREE_LIMIT, must fit the bits of the bin bitmap
+#define FREE_LIST_BINS 43
+
+// Size step of the exact bins, one bin every 16 bytes
+#define FREE_LIST_BIN_STEP 16
+
+// Sizes below this limit use exact bins, the others use geometric bins
+#define FREE_LIST_EXACT_LIMIT 512
+
+// Log2 of the number of geometric bins for each power of two
+#define FREE_LIST_SUB_BINS_LOG2 2
+
+// Blocks of this size and up are indexed by a tree ordered by size instead of the bins
+#define FREE_LIST_TREE_LIMIT 4096
+
+// Blocks recycled since the last coalescing pass from which a request missing the free list merges them again
+#define FREE_LIST_COALESCE_MIN 64
+
+// Age of a free block of the tree whose whole pages were given back to the system
+#define TREE_BLOCK_PURGED 2
+
+// Default amount of memory committed at once by virtual arenas
+#define DEFAULT_COMMIT_CHUNK (64 * 1024) // 64 KiB
+
+// Size of the huge pages promoted transparently by the kernel, the usual PMD size
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024) // 2 MiB
+
+// Size of the header in front of the heap of file-backed arenas
+#define ARENA_FILE_HEADER_SIZE 4096
 
 // Default memory alignment
 #define DEFAULT_ALLIGNMENT (2 * sizeof(void *)) // 16 bytes
@@ -22,44 +50,269 @@ typedef struct Block {
     struct Block *next;
 } Block;
 
+/**
+ * @brief Free block indexed by the size-ordered tree, a treap keyed by size then address
+ *
+ * The priority of each node is a hash of its address, so that the tree stays balanced without storing it.
+ *
+ * @param block size of the block, its next pointer is unused
+ * @param left blocks ordered before this one
+ * @param right blocks ordered after this one
+ * @param age decay passes the block stayed free through, TREE_BLOCK_PURGED once its pages were given back
+ */
+typedef struct TreeBlock {
+    Block block;
+    struct TreeBlock *left;
+    struct TreeBlock *right;
+    size_t age;
+} TreeBlock;
+
+/**
+ * @brief Free list of an arena, segregated into size bins
+ *
+ * @param bins lists of freed blocks and reusables, one for each size bin
+ * @param map bitmap of the non-empty bins
+ * @param tree blocks of FREE_LIST_TREE_LIMIT bytes and up, ordered by size
+ * @param recycled number of blocks recycled into the free list since it was last coalesced
+ * @param coalesced number of blocks left in the free list by the last coalescing pass
+ */
+typedef struct {
+    Block *bins[FREE_LIST_BINS];
+    uint64_t map;
+    TreeBlock *tree;
+    size_t recycled;
+    size_t coalesced;
+} FreeList;
+
 /**
  * @brief Allocation strategy for reusing blocks
  *
- * BestFit: Find the smallest block that fits the requested size
+ * BestFit: Find the smallest block that fits the requested size, an exact fit in the size bin is preferred
+ *
+ * FirstFit: Find the first block that fits the requested size, taken from the first non-empty bin that fits
  *
- * FirstFit: Find the first block that fits the requested size
+ * Blocks indexed by the tree are always the smallest that fits, whatever the strategy
  */
 typedef enum {
     BestFit = 0,
     FirstFit = 1,
 } AllocationStrategy;
 
+/**
+ * @brief Memory backing the arena
+ *
+ * BufferBacking: Buffer provided by the caller, the arena does not own it
+ *
+ * VirtualBacking: Address range reserved by the arena, pages are committed as the offset grows
+ *
+ * MappedBacking: Memory mapped by the arena as a whole, readable and writable from the start
+ *
+ * FileBacking: Shared mapping of a file, the state of the arena is kept in a header in front of the heap
+ *
+ * SharedBacking: Shared mapping of an anonymous memory file, snapshots of it are copy on write
+ */
+typedef enum {
+    BufferBacking = 0,
+    VirtualBacking = 1,
+    MappedBacking = 2,
+    FileBacking = 3,
+    SharedBacking = 4,
+} ArenaBacking;
+
+/**
+ * @brief Pages backing the memory of the arena
+ *
+ * DefaultPages: Base pages of the system
+ *
+ * TransparentHugePages: 2 MiB aligned memory advised with MADV_HUGEPAGE, the kernel promotes it when it can
+ *
+ * HugePages2M: Explicit 2 MiB pages reserved with MAP_HUGETLB
+ *
+ * HugePages1G: Explicit 1 GiB pages reserved with MAP_HUGETLB
+ */
+typedef enum {
+    DefaultPages = 0,
+    TransparentHugePages = 1,
+    HugePages2M = 2,
+    HugePages1G = 3,
+} ArenaPages;
+
+/**
+ * @brief Size classes used to report statistics of the free list
+ */
+typedef enum {
+    Small = 0,  // 0 - 64 bytes
+    Medium = 1, // 64 - 512 bytes
+    Large = 2,  // 512 - 4096 bytes
+    Huge = 3,   // 4096 - the rest
+} BlockClass;
+
+// Number of block classes
+#define BLOCK_CLASSES 4
+
+/**
+ * @brief Counters updated on the allocation path, only when the arena is compiled with ARENA_STATS
+ *
+ * @param high_water highest offset reached by the arena
+ * @param reuse_hits allocations served by a free block, for each class of the requested size
+ * @param reuse_misses allocations that found no free block and went to the offset, for each class
+ * @param padding bytes skipped or handed out with the allocations to keep them aligned
+ */
+typedef struct {
+    size_t high_water;
+    size_t reuse_hits[BLOCK_CLASSES];
+    size_t reuse_misses[BLOCK_CLASSES];
+    size_t padding;
+} ArenaCounters;
+
+/**
+ * @brief Statistics of an arena, filled by arena_stats
+ *
+ * @param offset current offset in the arena
+ * @param high_water highest offset reached by the arena, the current offset without ARENA_STATS
+ * @param committed amount of memory committed in the arena
+ * @param available memory past the offset still available to the arena
+ * @param free_blocks number of free blocks of each class, the ones kept aside by scopes included
+ * @param free_bytes bytes held by the free blocks of each class
+ * @param reuse_hits allocations served by a free block, for each class, zero without ARENA_STATS
+ * @param reuse_misses allocations that found no free block, for each class, zero without ARENA_STATS
+ * @param padding bytes lost to alignment padding since the arena was initialized, zero without ARENA_STATS
+ * @param largest_free_block size of the largest free block
+ * @param fragmentation external fragmentation, 1 minus the largest free range over the free memory, the memory
+ * past the offset counting as a single range
+ */
+typedef struct {
+    size_t offset;
+    size_t high_water;
+    size_t committed;
+    size_t available;
+    size_t free_blocks[BLOCK_CLASSES];
+    size_t free_bytes[BLOCK_CLASSES];
+    size_t reuse_hits[BLOCK_CLASSES];
+    size_t reuse_misses[BLOCK_CLASSES];
+    size_t padding;
+    size_t largest_free_block;
+    double fragmentation;
+} ArenaStats;
+
+/**
+ * @brief Sampler counting down the bytes allocated from an arena, only the sampled calls leave the allocation path
+ *
+ * Every allocation of the arena is counted, the ones of allocators built on top of it included. The hooks are called
+ * by the allocator entry points of the arena, so that their return address is in the entry point.
+ *
+ * @param until_sample bytes left to allocate before the next sample
+ * @param live number of sampled blocks still live, frees call forget only while it is not zero
+ * @param sample called with the allocation that used up the interval, must set until_sample again
+ * @param forget called with each block freed while live is not zero
+ * @param moved called with each reallocated block that is sampled or grows past the interval
+ */
+typedef struct ArenaSampler {
+    size_t until_sample;
+    size_t live;
+    void (*sample)(struct ArenaSampler *sampler, void *ptr, size_t size);
+    void (*forget)(struct ArenaSampler *sampler, void *ptr);
+    void (*moved)(struct ArenaSampler *sampler, void *ptr, void *new_ptr, size_t old_size, size_t new_size);
+} ArenaSampler;
+
 /**
  * @brief Arena structure for memory allocation
  *
  * @param base base address of the arena
  * @param align memory alignment of each block
  * @param size size of the arena
+ * @param mapped amount of memory readable and writable from the base, equal to size unless the arena is virtual
+ * @param commit_chunk granularity used to commit memory of virtual arenas
  * @param offset current offset in the arena
  * @param committed amount of memory committed in the arena
- * @param free_list list of freed blocks and reusables, divided into classes
+ * @param zeroed offset from which the memory is known to be zero, the highest offset reached on mapped memory
+ * @param free_list list of freed blocks and reusables, segregated into size bins
  * @param strategy allocation strategy for reusing blocks
+ * @param backing memory backing the arena
+ * @param pages pages backing the memory of the arena, as obtained from the system
+ * @param purge_threshold bytes of big blocks freed between two decay passes, 0 to only purge explicitly
+ * @param purge_pending bytes of big blocks freed since the last decay pass
+ * @param temp innermost scope of temporary allocations, null outside of any scope
+ * @param fd memory file of shared arenas, -1 otherwise
+ * @param snapshot live snapshot of a shared arena, null if none
+ * @param sampler sampler of the allocations, null if none
+ * @param counters statistics counters, left to zero unless the arena is compiled with ARENA_STATS
  */
 typedef struct {
     void *base;
     size_t align;
     size_t size;
+    size_t mapped;
+    size_t commit_chunk;
     size_t offset;
     size_t committed;
-    Block *free_list[FREE_LIST_CLASSES];
+    size_t zeroed;
+    FreeList free_list;
     AllocationStrategy strategy;
+    ArenaBacking backing;
+    ArenaPages pages;
+    size_t purge_threshold;
+    size_t purge_pending;
+    struct ArenaTemp *temp;
+    int fd;
+    struct ArenaSnapshot *snapshot;
+    ArenaSampler *sampler;
+    ArenaCounters counters;
 } Arena;
 
+/**
+ * @brief Scope of temporary allocations, everything allocated inside it is dropped at once when it ends
+ *
+ * Allocations inside a scope only reuse blocks freed inside the same scope, blocks freed before the scope began are
+ * kept aside and come back when it ends.
+ *
+ * @param arena arena the scope belongs to
+ * @param offset offset of the arena when the scope began
+ * @param committed memory committed in the arena when the scope began, minus what was freed of it inside the scope
+ * @param free_list free list of the arena when the scope began, plus what was freed of it inside the scope
+ * @param prev enclosing scope, null for the outermost one
+ */
+typedef struct ArenaTemp {
+    Arena *arena;
+    size_t offset;
+    size_t committed;
+    FreeList free_list;
+    struct ArenaTemp *prev;
+} ArenaTemp;
+
+/**
+ * @brief Read-only copy-on-write view of a shared arena, as it was when the snapshot was taken
+ *
+ * Pointers stored in the arena point to the live heap, they are read in the snapshot through arena_snapshot_ptr.
+ *
+ * @param arena arena the snapshot was taken of
+ * @param base start of the view of the heap
+ * @param offset offset of the arena when the snapshot was taken
+ * @param committed memory committed in the arena when the snapshot was taken
+ */
+typedef struct ArenaSnapshot {
+    Arena *arena;
+    const void *base;
+    size_t offset;
+    size_t committed;
+} ArenaSnapshot;
+
 /**
  * @brief Initialize an allocator with an arena
  */
 #define arena_alloc_init(a)                                                                                            \
-    (Allocator) { arena_alloc, arena_free, arena_realloc, arena_calloc, arena_allocated, a }
+    (Allocator) { arena_alloc, arena_free, arena_realloc, arena_calloc, arena_allocated, a, arena_alloc_aligned_ex }
+
+/**
+ * @brief Initialize an allocator with an append-only arena safe to share between threads
+ *
+ * Allocations never take a lock, frees only update the accounting and the memory is reclaimed by arena_free_all.
+ */
+#define arena_atomic_alloc_init(a)                                                                                     \
+    (Allocator) {                                                                                                      \
+        arena_atomic_alloc, arena_atomic_free, arena_atomic_realloc, arena_atomic_calloc, arena_atomic_allocated, a,   \
+            arena_atomic_alloc_aligned                                                                                 \
+    }
 
 /**
  * @brief Initialize an arena with a buffer, size, alignment and allocation strategy
@@ -71,6 +324,134 @@ typedef struct {
  * @return Arena
  */
 Arena arena_init(void *buffer, size_t size, size_t align, AllocationStrategy strategy);
+/**
+ * @brief Initialize an arena on a reserved range of virtual memory, pages are committed lazily as the offset grows
+ *
+ * Reserving costs no memory, the arena can be as big as the address space allows and its pointers never move.
+ *
+ * @param reserve size of the address range to reserve, rounded up to the page size
+ * @param commit_chunk amount of memory committed at once, rounded up to the page size, 0 for DEFAULT_COMMIT_CHUNK
+ * @param align alignment of the buffer, must be a power of 2, use DEFAULT_ALLIGNMENT for default
+ * @param strategy strategy for reusing blocks
+ * @return Arena arena with a null base if the range could not be reserved
+ */
+Arena arena_init_virtual(size_t reserve, size_t commit_chunk, size_t align, AllocationStrategy strategy);
+/**
+ * @brief Initialize an arena on memory backed by huge pages, to cut the TLB misses of big arenas
+ *
+ * Explicit huge pages are tried first, from the requested size down to 2 MiB, then transparent huge pages on a 2 MiB
+ * aligned mapping. The pages actually obtained are reported in the pages field of the arena, DefaultPages when the
+ * system supports none of them.
+ *
+ * @param size size of the arena, rounded up to the size of the pages obtained
+ * @param pages largest pages to try, DefaultPages maps the arena with base pages
+ * @param align alignment of the buffer, must be a power of 2, use DEFAULT_ALLIGNMENT for default
+ * @param strategy strategy for reusing blocks
+ * @return Arena arena with a null base if the memory could not be mapped
+ */
+Arena arena_init_huge(size_t size, ArenaPages pages, size_t align, AllocationStrategy strategy);
+/**
+ * @brief Initialize an arena on a file, reopening the file restores the heap as it was last synced
+ *
+ * The file holds a header with the offset, the accounting and the free list of the arena, followed by the heap. The
+ * heap is mapped back at its previous address when it is free, otherwise the free list is relocated. Pointers stored
+ * in the heap by the caller are not, data meant to survive a move should link with arena_offset_of and arena_at.
+ *
+ * @param path path of the file, created if it does not exist
+ * @param size size of the heap of a new file, rounded up to the page size, ignored when reopening
+ * @param align alignment of a new arena, must be a power of 2, ignored when reopening
+ * @param strategy strategy for reusing blocks of a new arena, ignored when reopening
+ * @return Arena arena with a null base if the file could not be mapped or is not an arena file
+ */
+Arena arena_init_file(const char *path, size_t size, size_t align, AllocationStrategy strategy);
+/**
+ * @brief Write the state of a file-backed arena to its header and flush the heap to the file
+ *
+ * @param a arena to sync, no scope of temporary allocations may be open
+ * @return int 0 on success, -1 if the arena is not file-backed, a scope is open or the file could not be written
+ */
+int arena_sync(Arena *a);
+/**
+ * @brief Set the root of a file-backed arena, the entry point to the data found back when the file is reopened
+ *
+ * @param a file-backed arena
+ * @param root pointer into the heap, null to clear it
+ */
+void arena_set_root(Arena *a, void *root);
+/**
+ * @brief Get the root of a file-backed arena
+ *
+ * @param a file-backed arena
+ * @return void* root set last, null if none
+ */
+void *arena_get_root(Arena *a);
+/**
+ * @brief Initialize an arena on an anonymous memory file, so that snapshots of it can be taken
+ *
+ * Only available on Linux, other systems get an arena with a null base.
+ *
+ * @param size size of the arena, rounded up to the page size
+ * @param align alignment of the buffer, must be a power of 2, use DEFAULT_ALLIGNMENT for default
+ * @param strategy strategy for reusing blocks
+ * @return Arena arena with a null base if the memory file could not be created
+ */
+Arena arena_init_shared(size_t size, size_t align, AllocationStrategy strategy);
+/**
+ * @brief Take a copy-on-write snapshot of a shared arena in constant time
+ *
+ * The memory file is frozen and the live heap is mapped privately over it, so that only the pages written afterwards
+ * are copied. A single snapshot can be live at once, the arena must not be written while the call runs.
+ *
+ * @param a shared arena
+ * @param snapshot snapshot to fill
+ * @return int 0 on success, -1 if the arena is not shared, already has a live snapshot or could not be remapped
+ */
+int arena_snapshot(Arena *a, ArenaSnapshot *snapshot);
+/**
+ * @brief Release a snapshot, the pages written since it was taken go back to the memory file
+ *
+ * The arena must not be written while the call runs. If the pages cannot be written back, the snapshot stays live and
+ * the heap keeps its private copies, so that the release can be retried without losing a write.
+ *
+ * @param snapshot snapshot to release
+ * @return int 0 on success, -1 if the written pages could not go back to the memory file
+ */
+int arena_snapshot_release(ArenaSnapshot *snapshot);
+/**
+ * @brief Translate a pointer into the live heap to the same memory in a snapshot
+ *
+ * @param snapshot snapshot to read
+ * @param ptr pointer into the live heap, null stays null
+ * @return const void* pointer to the memory as it was when the snapshot was taken
+ */
+static inline const void *arena_snapshot_ptr(ArenaSnapshot *snapshot, const void *ptr) {
+    return ptr ? (const uint8_t *)snapshot->base + ((const uint8_t *)ptr - (uint8_t *)snapshot->arena->base) : 0;
+}
+/**
+ * @brief Get the offset of a pointer from the base of the arena, it stays valid when the heap moves
+ *
+ * @param a arena the pointer belongs to
+ * @param ptr pointer into the heap
+ * @return size_t offset of the pointer
+ */
+static inline size_t arena_offset_of(Arena *a, void *ptr) { return (size_t)((uint8_t *)ptr - (uint8_t *)a->base); }
+/**
+ * @brief Get the pointer at an offset from the base of the arena
+ *
+ * @param a arena the offset belongs to
+ * @param offset offset from the base of the arena
+ * @return void* pointer into the heap
+ */
+static inline void *arena_at(Arena *a, size_t offset) { return (uint8_t *)a->base + offset; }
+/**
+ * @brief Release the memory owned by the arena, buffers provided by the caller are left untouched
+ *
+ * File-backed arenas are synced before they are unmapped. A live snapshot of a shared arena is released along with it,
+ * its view is unmapped without writing anything back.
+ *
+ * @param a arena to destroy
+ */
+void arena_destroy(Arena *a);
 /**
  * @brief Allocate memory from the arena
  *
@@ -79,19 +460,34 @@ Arena arena_init(void *buffer, size_t size, size_t align, AllocationStrategy str
  * @return void* pointer to the allocated memory
  */
 void *arena_alloc(size_t size, void *context);
+/**
+ * @brief Allocate memory from the arena aligned to the given boundary
+ *
+ * Free blocks are reused only if they can hold the aligned memory, the padding in front of it goes back to the free
+ * list. Reallocating the memory keeps the alignment only if it does not move.
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2, alignments below the arena one are raised to it
+ * @param context arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *arena_alloc_aligned_ex(size_t size, size_t align, void *context);
 /**
  * @brief Reallocate memory from the arena
  *
- * @param new_size new size of the memory to allocate
+ * @param new_size new size of the memory to allocate, 0 frees the memory
  * @param old_size old size of the memory to reallocate
  * @param ptr pointer to the memory to reallocate
  * @param context arena to reallocate from, is a void* to statify the Allocator interface
- * @return void* pointer to the reallocated memory
+ * @return void* pointer to the reallocated memory, null once freed
  */
 void *arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
 /**
  * @brief Allocate memory from the arena and set it to zero
  *
+ * Memory of mapped arenas that was never handed out is already zero and is not set again, only the part of the block
+ * below the highest offset ever reached is cleared.
+ *
  * @param count number of elements to allocate
  * @param size size of each element
  * @param context arena to allocate from, is a void* to statify the Allocator interface
@@ -107,11 +503,98 @@ void *arena_calloc(size_t count, size_t size, void *context);
  */
 void arena_free(size_t size, void *ptr, void *context);
 /**
- * @brief Free all memory from the arena
+ * @brief Allocate many blocks of the same size at once
+ *
+ * Blocks of the exact size are taken from their bin first, the rest is carved from a single bump of the offset and
+ * only falls back to one allocation at a time when the arena has no contiguous room left.
+ *
+ * @param count number of blocks to allocate
+ * @param size size of each block
+ * @param out pointers to the allocated blocks, filled from the start
+ * @param context arena to allocate from, is a void* to statify the Allocator interface
+ * @return size_t number of blocks allocated, less than count if the arena is full
+ */
+size_t arena_alloc_batch(size_t count, size_t size, void **out, void *context);
+/**
+ * @brief Free many blocks of the same size at once
+ *
+ * The blocks are chained together and spliced into their bin in one go, the block on top of the arena still rewinds
+ * the offset.
+ *
+ * @param count number of blocks to free
+ * @param size size of each block
+ * @param ptrs pointers to the blocks to free, null pointers are skipped
+ * @param context arena to free from, is a void* to statify the Allocator interface
+ */
+void arena_free_batch(size_t count, size_t size, void **ptrs, void *context);
+/**
+ * @brief Free all memory from the arena, the open scopes of temporary allocations end as well
  *
  * @param context arena to free from, is a void* to statify the Allocator interface
  */
 void arena_free_all(void *context);
+/**
+ * @brief Begin a scope of temporary allocations, scopes can be nested
+ *
+ * @param temp scope to begin, must outlive the scope
+ * @param a arena to allocate from
+ */
+void arena_temp_begin(ArenaTemp *temp, Arena *a);
+/**
+ * @brief End a scope of temporary allocations, everything allocated inside it is freed at once
+ *
+ * The scopes nested in it, if still open, end as well.
+ *
+ * @param temp scope to end
+ */
+void arena_temp_end(ArenaTemp *temp);
+/**
+ * @brief Merge the adjacent free blocks of the arena, the free block on top of the arena moves the offset back down
+ *
+ * It runs on its own when the arena is full, calling it explicitly compacts the free list ahead of time.
+ *
+ * @param context arena to coalesce, is a void* to statify the Allocator interface
+ */
+void arena_coalesce(void *context);
+/**
+ * @brief Give the whole pages of the free memory of the arena back to the system
+ *
+ * Pages inside the free blocks of the tree and above the offset are released, memory of the buffer of the arena must
+ * be private to it. Shared arenas are not purged while a snapshot of them is live.
+ *
+ * @param a arena to purge
+ * @return size_t number of bytes given back
+ */
+size_t arena_purge(Arena *a);
+/**
+ * @brief Purge the arena as big blocks are freed, each time threshold bytes of them were freed
+ *
+ * A decay pass purges the blocks of the tree already free at the previous pass, and the pages more than threshold
+ * bytes above the offset. Blocks reused quickly are never purged.
+ *
+ * @param a arena to purge
+ * @param threshold bytes of big blocks freed between two passes, 0 to only purge with arena_purge
+ */
+void arena_set_purge_threshold(Arena *a, size_t threshold);
+/**
+ * @brief Count the allocations of the arena down with a sampler
+ *
+ * Without a sampler, the allocation path only checks for it. The blocks dropped by arena_free_all or by the end of a
+ * scope are not reported to the sampler.
+ *
+ * @param a arena to sample
+ * @param sampler sampler to count with, null to stop sampling
+ */
+void arena_set_sampler(Arena *a, ArenaSampler *sampler);
+/**
+ * @brief Get the statistics of the arena
+ *
+ * The free list is walked to measure it, the call is meant for diagnostics and not for the hot path.
+ *
+ * @param a arena to inspect
+ * @param stats statistics to fill
+ */
+void arena_stats(Arena *a, ArenaStats *stats);
 /**
  * @brief Get the total allocated memory from the arena
  *
@@ -119,5 +602,68 @@ void arena_free_all(void *context);
  * @return size_t total allocated memory
  */
 static inline size_t arena_allocated(void *context) { return ((Arena *)context)->committed; }
+/**
+ * @brief Allocate memory from the arena, wait-free and safe to call from many threads at once
+ *
+ * The offset is reserved with an atomic fetch-add, the free list is never used.
+ *
+ * @param size size of the memory to allocate
+ * @param context arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *arena_atomic_alloc(size_t size, void *context);
+/**
+ * @brief Allocate memory from the arena aligned to the given boundary, safe to call from many threads at once
+ *
+ * Alignments above the arena one reserve the offset with a compare-and-swap loop, lock-free but not wait-free.
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2, alignments below the arena one are raised to it
+ * @param context arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *arena_atomic_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Reallocate memory from the arena, safe to call from many threads at once
+ *
+ * A shrunk block stays in place. A grown block always moves, the old block stays in the arena until arena_free_all.
+ *
+ * @param new_size new size of the memory to allocate
+ * @param old_size old size of the memory to reallocate
+ * @param ptr pointer to the memory to reallocate
+ * @param context arena to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory
+ */
+void *arena_atomic_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Allocate memory from the arena and set it to zero, safe to call from many threads at once
+ *
+ * Like arena_calloc, memory of mapped arenas that was never handed out is not set again.
+ *
+ * @param count number of elements to allocate
+ * @param size size of each element
+ * @param context arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *arena_atomic_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Account memory as freed, safe to call from many threads at once
+ *
+ * The memory is not reused, it is reclaimed by arena_free_all.
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context arena to free from, is a void* to statify the Allocator interface
+ */
+void arena_atomic_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Get the total allocated memory from an arena shared between threads
+ *
+ * @param context arena to get the allocated memory from, is a void* to statify the Allocator interface
+ * @return size_t total allocated memory
+ */
+static inline size_t arena_atomic_allocated(void *context) {
+    return __atomic_load_n(&((Arena *)context)->committed, __ATOMIC_RELAXED);
+}
 
 #endif // _ARENA_H
@@ -0,0 +1,445 @@
+#include "concurrent_arena.h"
+
+#include <memory.h>
+#include <stdlib.h>
+
+/**
+ * @brief Get the cache of the calling thread, creating it on first use
+ *
+ * @param c concurrent arena the cache belongs to
+ * @return ThreadCache* cache of the calling thread, null if it could not be created
+ */
+static ThreadCache *concurrent_arena_get_cache(ConcurrentArena *c);
+/**
+ * @brief Refill a size class of a thread cache with a batch from its central list, or from the central arena
+ *
+ * @param c concurrent arena owning the central arena
+ * @param cache cache to refill
+ * @param class size class to refill
+ */
+static void concurrent_arena_refill(ConcurrentArena *c, ThreadCache *cache, size_t class);
+/**
+ * @brief Give cached blocks of a size class back to the central arena, the lock must be held
+ *
+ * @param c concurrent arena owning the central arena
+ * @param cache cache to flush
+ * @param class size class to flush
+ * @param count number of blocks to flush
+ */
+static void concurrent_arena_flush_class(ConcurrentArena *c, ThreadCache *cache, size_t class, size_t count);
+/**
+ * @brief Move a batch of cached blocks of a size class to its central list, or to the central arena if the list is full
+ *
+ * @param c concurrent arena owning the central lists
+ * @param cache cache to flush, holding at least a batch of the class
+ * @param class size class to flush
+ */
+static void concurrent_arena_flush_batch(ConcurrentArena *c, ThreadCache *cache, size_t class);
+/**
+ * @brief Give a chain of blocks of a size class back to the central arena, the lock must be held
+ *
+ * @param c concurrent arena owning the central arena
+ * @param block first block of the chain
+ * @param class size class of the blocks
+ */
+static void concurrent_arena_free_chain(ConcurrentArena *c, CachedBlock *block, size_t class);
+/**
+ * @brief Release the cache of an exiting thread, its blocks go back to the central arena
+ *
+ * @param ptr cache to release
+ */
+static void thread_cache_release(void *ptr);
+/**
+ * @brief Add to the memory accounted by a thread cache, readers may sum it from other threads
+ *
+ * @param cache cache of the calling thread
+ * @param size amount to add, wraps around to subtract
+ */
+static inline void thread_cache_account(ThreadCache *cache, size_t size);
+/**
+ * @brief Get the cached size class of a size
+ *
+ * @param size size of the block
+ * @return size_t size class, THREAD_CACHE_CLASSES if the size is not cached
+ */
+static inline size_t get_cache_class(size_t size);
+
+int concurrent_arena_init(ConcurrentArena *c, Arena arena) {
+    int err = pthread_mutex_init(&c->lock, 0);
+    if (err) {
+        return err;
+    }
+
+    size_t class = 0;
+    while (class < THREAD_CACHE_CLASSES && !(err = pthread_mutex_init(&c->central[class].lock, 0))) {
+        c->central[class].batches = 0;
+        c->central[class].count = 0;
+        class++;
+    }
+    if (!err) {
+        err = pthread_key_create(&c->key, thread_cache_release);
+    }
+    if (err) {
+        // only the locks initialized so far are destroyed
+        while (class--) {
+            pthread_mutex_destroy(&c->central[class].lock);
+        }
+        pthread_mutex_destroy(&c->lock);
+        return err;
+    }
+
+    c->arena = arena;
+    c->caches = 0;
+    c->retired = 0;
+    return 0;
+}
+
+void concurrent_arena_destroy(ConcurrentArena *c) {
+    pthread_key_delete(c->key);
+
+    ThreadCache *cache = c->caches;
+    while (cache) {
+        ThreadCache *next = cache->next;
+        free(cache);
+        cache = next;
+    }
+    c->caches = 0;
+
+    for (size_t class = 0; class < THREAD_CACHE_CLASSES; class++) {
+        pthread_mutex_destroy(&c->central[class].lock);
+    }
+    pthread_mutex_destroy(&c->lock);
+    arena_destroy(&c->arena);
+}
+
+void *concurrent_arena_alloc(size_t size, void *context) {
+    ConcurrentArena *c = (ConcurrentArena *)context;
+    ThreadCache *cache = concurrent_arena_get_cache(c);
+    if (!size || !cache) {
+        return 0;
+    }
+
+    size_t class = get_cache_class(size);
+    if (class == THREAD_CACHE_CLASSES) {
+        pthread_mutex_lock(&c->lock);
+        void *ptr = arena_alloc(size, &c->arena);
+        pthread_mutex_unlock(&c->lock);
+        if (ptr) {
+            thread_cache_account(cache, size);
+        }
+        return ptr;
+    }
+
+    if (!cache->blocks[class]) {
+        concurrent_arena_refill(c, cache, class);
+        if (!cache->blocks[class]) {
+            return 0;
+        }
+    }
+
+    CachedBlock *block = cache->blocks[class];
+    cache->blocks[class] = block->next;
+    cache->count[class]--;
+    thread_cache_account(cache, size);
+
+    return (void *)block;
+}
+
+void *concurrent_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    if (!ptr) {
+        return concurrent_arena_alloc(new_size, context);
+    }
+    // like realloc, a size of zero frees the block and nothing is left to point to
+    if (!new_size) {
+        concurrent_arena_free(old_size, ptr, context);
+        return 0;
+    }
+
+    size_t class = get_cache_class(old_size);
+    if (class < THREAD_CACHE_CLASSES && class == get_cache_class(new_size)) {
+        ThreadCache *cache = concurrent_arena_get_cache((ConcurrentArena *)context);
+        if (!cache) {
+            return 0;
+        }
+        thread_cache_account(cache, new_size - old_size);
+        return ptr;
+    }
+
+    void *new_ptr = concurrent_arena_alloc(new_size, context);
+    if (!new_ptr) {
+        return 0;
+    }
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    concurrent_arena_free(old_size, ptr, context);
+    return new_ptr;
+}
+
+void *concurrent_arena_calloc(size_t count, size_t size, void *context) {
+    ConcurrentArena *c = (ConcurrentArena *)context;
+    size_t total_size = count * size;
+
+    // big blocks come from the central arena, which skips clearing the memory it never handed out
+    if (total_size && get_cache_class(total_size) == THREAD_CACHE_CLASSES) {
+        ThreadCache *cache = concurrent_arena_get_cache(c);
+        if (!cache) {
+            return 0;
+        }
+        pthread_mutex_lock(&c->lock);
+        void *ptr = arena_calloc(count, size, &c->arena);
+        pthread_mutex_unlock(&c->lock);
+        if (ptr) {
+            thread_cache_account(cache, total_size);
+        }
+        return ptr;
+    }
+
+    void *ptr = concurrent_arena_alloc(total_size, context);
+    if (ptr) {
+        memset(ptr, 0, total_size);
+    }
+    return ptr;
+}
+
+void *concurrent_arena_alloc_aligned(size_t size, size_t align, void *context) {
+    ConcurrentArena *c = (ConcurrentArena *)context;
+    if (align <= c->arena.align) {
+        return concurrent_arena_alloc(size, context);
+    }
+
+    ThreadCache *cache = concurrent_arena_get_cache(c);
+    if (!size || !cache) {
+        return 0;
+    }
+
+    // cached sizes take a whole class, so that the block can join the thread cache once freed
+    size_t class = get_cache_class(size);
+    size_t block_size = class < THREAD_CACHE_CLASSES ? (class + 1) * THREAD_CACHE_STEP : size;
+
+    pthread_mutex_lock(&c->lock);
+    void *ptr = arena_alloc_aligned_ex(block_size, align, &c->arena);
+    pthread_mutex_unlock(&c->lock);
+    if (ptr) {
+        thread_cache_account(cache, size);
+    }
+    return ptr;
+}
+
+void concurrent_arena_free(size_t size, void *ptr, void *context) {
+    ConcurrentArena *c = (ConcurrentArena *)context;
+    ThreadCache *cache = concurrent_arena_get_cache(c);
+    if (!ptr || !cache) {
+        return;
+    }
+
+    thread_cache_account(cache, -size);
+
+    size_t class = get_cache_class(size);
+    if (class == THREAD_CACHE_CLASSES) {
+        pthread_mutex_lock(&c->lock);
+        arena_free(size, ptr, &c->arena);
+        pthread_mutex_unlock(&c->lock);
+        return;
+    }
+
+    CachedBlock *block = (CachedBlock *)ptr;
+    block->next = cache->blocks[class];
+    cache->blocks[class] = block;
+    cache->count[class]++;
+
+    if (cache->count[class] > THREAD_CACHE_CAPACITY) {
+        concurrent_arena_flush_batch(c, cache, class);
+    }
+}
+
+void concurrent_arena_flush(void *context) {
+    ConcurrentArena *c = (ConcurrentArena *)context;
+    ThreadCache *cache = pthread_getspecific(c->key);
+    if (!cache) {
+        return;
+    }
+
+    pthread_mutex_lock(&c->lock);
+    for (size_t class = 0; class < THREAD_CACHE_CLASSES; class++) {
+        concurrent_arena_flush_class(c, cache, class, cache->count[class]);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+void concurrent_arena_trim(void *context) {
+    ConcurrentArena *c = (ConcurrentArena *)context;
+
+    for (size_t class = 0; class < THREAD_CACHE_CLASSES; class++) {
+        CentralList *central = &c->central[class];
+        pthread_mutex_lock(&central->lock);
+        CachedBlock *batches = central->batches;
+        central->batches = 0;
+        central->count = 0;
+        pthread_mutex_unlock(&central->lock);
+
+        if (batches) {
+            pthread_mutex_lock(&c->lock);
+            while (batches) {
+                CachedBlock *next = batches->batch;
+                concurrent_arena_free_chain(c, batches, class);
+                batches = next;
+            }
+            pthread_mutex_unlock(&c->lock);
+        }
+    }
+}
+
+size_t concurrent_arena_allocated(void *context) {
+    ConcurrentArena *c = (ConcurrentArena *)context;
+
+    pthread_mutex_lock(&c->lock);
+    size_t committed = c->retired;
+    for (ThreadCache *cache = c->caches; cache; cache = cache->next) {
+        committed += __atomic_load_n(&cache->committed, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    return committed;
+}
+
+static ThreadCache *concurrent_arena_get_cache(ConcurrentArena *c) {
+    ThreadCache *cache = pthread_getspecific(c->key);
+    if (cache) {
+        return cache;
+    }
+
+    cache = calloc(1, sizeof(ThreadCache));
+    if (!cache) {
+        return 0;
+    }
+    cache->owner = c;
+
+    if (pthread_setspecific(c->key, cache)) {
+        free(cache);
+        return 0;
+    }
+
+    pthread_mutex_lock(&c->lock);
+    cache->next = c->caches;
+    c->caches = cache;
+    pthread_mutex_unlock(&c->lock);
+
+    return cache;
+}
+
+static void concurrent_arena_refill(ConcurrentArena *c, ThreadCache *cache, size_t class) {
+    size_t size = (class + 1) * THREAD_CACHE_STEP;
+
+    CentralList *central = &c->central[class];
+    pthread_mutex_lock(&central->lock);
+    CachedBlock *batch = central->batches;
+    if (batch) {
+        central->batches = batch->batch;
+        central->count--;
+    }
+    pthread_mutex_unlock(&central->lock);
+
+    if (batch) {
+        cache->blocks[class] = batch;
+        cache->count[class] = THREAD_CACHE_BATCH;
+        return;
+    }
+
+    pthread_mutex_lock(&c->lock);
+    for (size_t i = 0; i < THREAD_CACHE_BATCH; i++) {
+        CachedBlock *block = arena_alloc(size, &c->arena);
+        if (!block) {
+            break;
+        }
+        block->next = cache->blocks[class];
+        cache->blocks[class] = block;
+        cache->count[class]++;
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void concurrent_arena_flush_class(ConcurrentArena *c, ThreadCache *cache, size_t class, size_t count) {
+    size_t size = (class + 1) * THREAD_CACHE_STEP;
+
+    while (count-- && cache->blocks[class]) {
+        CachedBlock *block = cache->blocks[class];
+        cache->blocks[class] = block->next;
+        cache->count[class]--;
+        arena_free(size, block, &c->arena);
+    }
+}
+
+static void concurrent_arena_flush_batch(ConcurrentArena *c, ThreadCache *cache, size_t class) {
+    // the batch is cut from the thread cache before any lock is taken
+    CachedBlock *batch = cache->blocks[class];
+    CachedBlock *last = batch;
+    for (size_t i = 1; i < THREAD_CACHE_BATCH; i++) {
+        last = last->next;
+    }
+    cache->blocks[class] = last->next;
+    cache->count[class] -= THREAD_CACHE_BATCH;
+    last->next = 0;
+
+    CentralList *central = &c->central[class];
+    pthread_mutex_lock(&central->lock);
+    if (central->count < THREAD_CACHE_CENTRAL_BATCHES) {
+        batch->batch = central->batches;
+        central->batches = batch;
+        central->count++;
+        batch = 0;
+    }
+    pthread_mutex_unlock(&central->lock);
+
+    if (batch) {
+        pthread_mutex_lock(&c->lock);
+        concurrent_arena_free_chain(c, batch, class);
+        pthread_mutex_unlock(&c->lock);
+    }
+}
+
+static void concurrent_arena_free_chain(ConcurrentArena *c, CachedBlock *block, size_t class) {
+    size_t size = (class + 1) * THREAD_CACHE_STEP;
+
+    while (block) {
+        CachedBlock *next = block->next;
+        arena_free(size, block, &c->arena);
+        block = next;
+    }
+}
+
+static void thread_cache_release(void *ptr) {
+    ThreadCache *cache = (ThreadCache *)ptr;
+    ConcurrentArena *c = cache->owner;
+
+    // full batches are kept for the other threads, the rest goes back to the central arena
+    for (size_t class = 0; class < THREAD_CACHE_CLASSES; class++) {
+        while (cache->count[class] >= THREAD_CACHE_BATCH) {
+            concurrent_arena_flush_batch(c, cache, class);
+        }
+    }
+
+    pthread_mutex_lock(&c->lock);
+    for (size_t class = 0; class < THREAD_CACHE_CLASSES; class++) {
+        concurrent_arena_flush_class(c, cache, class, cache->count[class]);
+    }
+    c->retired += cache->committed;
+
+    ThreadCache **link = &c->caches;
+    while (*link != cache) {
+        link = &(*link)->next;
+    }
+    *link = cache->next;
+    pthread_mutex_unlock(&c->lock);
+
+    free(cache);
+}
+
+static inline void thread_cache_account(ThreadCache *cache, size_t size) {
+    __atomic_store_n(&cache->committed, cache->committed + size, __ATOMIC_RELAXED);
+}
+
+static inline size_t get_cache_class(size_t size) {
+    if (size > THREAD_CACHE_CLASSES * THREAD_CACHE_STEP) {
+        return THREAD_CACHE_CLASSES;
+    }
+    return size ? (size - 1) / THREAD_CACHE_STEP : 0;
+}
@@ -0,0 +1,188 @@
+#ifndef _CONCURRENT_ARENA_H
+#define _CONCURRENT_ARENA_H
+
+#include "arena.h"
+#include <pthread.h>
+
+// Number of size classes cached by each thread, bigger sizes go straight to the central arena
+#define THREAD_CACHE_CLASSES 32
+
+// Size step of the cached size classes
+#define THREAD_CACHE_STEP 16
+
+// Maximum number of blocks cached by a thread for each size class
+#define THREAD_CACHE_CAPACITY 64
+
+// Number of blocks moved at once between a thread cache and the central lists or the central arena
+#define THREAD_CACHE_BATCH 32
+
+// Maximum number of batches kept by the central list of each size class, more go back to the central arena
+#define THREAD_CACHE_CENTRAL_BATCHES 64
+
+// Size of a cache line, the central lists do not share one
+#define THREAD_CACHE_LINE 64
+
+/**
+ * @brief Cached block of a thread cache or a central list, stored inside the block itself
+ *
+ * @param next pointer to the next block of the batch or the cache
+ * @param batch pointer to the next batch of a central list, only set on the first block of a batch
+ */
+typedef struct CachedBlock {
+    struct CachedBlock *next;
+    struct CachedBlock *batch;
+} CachedBlock;
+
+/**
+ * @brief Batches of blocks of one size class shared between threads, each class has its own lock
+ *
+ * @param lock lock of the list
+ * @param batches list of full batches, linked through their first block
+ * @param count number of batches in the list
+ */
+typedef struct CentralList {
+    _Alignas(THREAD_CACHE_LINE) pthread_mutex_t lock;
+    CachedBlock *batches;
+    size_t count;
+} CentralList;
+
+/**
+ * @brief Per-thread cache of blocks, divided into size classes
+ *
+ * @param blocks list of cached blocks for each size class
+ * @param count number of cached blocks for each size class
+ * @param committed memory allocated by the thread minus the memory it freed, wraps around when negative
+ * @param owner concurrent arena the cache belongs to
+ * @param next next cache in the registry of the concurrent arena
+ */
+typedef struct ThreadCache {
+    CachedBlock *blocks[THREAD_CACHE_CLASSES];
+    size_t count[THREAD_CACHE_CLASSES];
+    size_t committed;
+    struct ConcurrentArena *owner;
+    struct ThreadCache *next;
+} ThreadCache;
+
+/**
+ * @brief Thread-safe arena, threads allocate from their own caches and exchange batches through central lists
+ *
+ * A thread cache refills and flushes a size class a batch at a time through the central list of the class, so that
+ * threads working on different classes never wait on each other. The central arena is only locked to carve new
+ * batches, to take back the batches a full central list cannot keep and for sizes above the cached classes. The
+ * concurrent arena is aligned to THREAD_CACHE_LINE, aligned_alloc keeps that alignment on the heap.
+ *
+ * @param arena central arena, guarded by lock
+ * @param lock lock of the central arena and of the registry of caches
+ * @param key thread-specific key of the thread caches
+ * @param caches registry of the thread caches
+ * @param retired memory accounted by the caches of exited threads
+ * @param central central list of each size class
+ */
+typedef struct ConcurrentArena {
+    Arena arena;
+    pthread_mutex_t lock;
+    pthread_key_t key;
+    ThreadCache *caches;
+    size_t retired;
+    CentralList central[THREAD_CACHE_CLASSES];
+} ConcurrentArena;
+
+/**
+ * @brief Initialize an allocator with a concurrent arena
+ */
+#define concurrent_arena_alloc_init(c)                                                                                 \
+    (Allocator) {                                                                                                      \
+        concurrent_arena_alloc, concurrent_arena_free, concurrent_arena_realloc, concurrent_arena_calloc,              \
+            concurrent_arena_allocated, c, concurrent_arena_alloc_aligned                                              \
+    }
+
+/**
+ * @brief Initialize a concurrent arena on top of an arena, the concurrent arena takes ownership of it
+ *
+ * The concurrent arena must not be moved or copied once initialized.
+ *
+ * @param c concurrent arena to initialize
+ * @param arena central arena
+ * @return int 0 on success, an error number otherwise
+ */
+int concurrent_arena_init(ConcurrentArena *c, Arena arena);
+/**
+ * @brief Destroy a concurrent arena, every thread that used it must have exited
+ *
+ * The caches of the threads still running are freed along with the concurrent arena while their thread keeps pointing
+ * to them, a later call from such a thread would use freed memory. The central arena is destroyed too, see
+ * arena_destroy.
+ *
+ * @param c concurrent arena to destroy
+ */
+void concurrent_arena_destroy(ConcurrentArena *c);
+/**
+ * @brief Allocate memory from the concurrent arena
+ *
+ * @param size size of the memory to allocate
+ * @param context concurrent arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *concurrent_arena_alloc(size_t size, void *context);
+/**
+ * @brief Reallocate memory from the concurrent arena
+ *
+ * @param new_size new size of the memory to allocate
+ * @param old_size old size of the memory to reallocate
+ * @param ptr pointer to the memory to reallocate
+ * @param context concurrent arena to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory
+ */
+void *concurrent_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Allocate memory from the concurrent arena and set it to zero
+ *
+ * @param count number of elements to allocate
+ * @param size size of each element
+ * @param context concurrent arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *concurrent_arena_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Allocate memory from the concurrent arena aligned to the given boundary
+ *
+ * Alignments up to the arena one are served by the thread cache, bigger ones lock the central arena.
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2
+ * @param context concurrent arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *concurrent_arena_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Free memory from the concurrent arena, from any thread
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context concurrent arena to free from, is a void* to statify the Allocator interface
+ */
+void concurrent_arena_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Give the blocks cached by the calling thread back to the central arena
+ *
+ * @param context concurrent arena to flush, is a void* to statify the Allocator interface
+ */
+void concurrent_arena_flush(void *context);
+/**
+ * @brief Give the batches kept by the central lists back to the central arena
+ *
+ * The blocks of a size class are only reused for that class while they sit in its central list, trimming makes them
+ * available to any size again.
+ *
+ * @param context concurrent arena to trim, is a void* to statify the Allocator interface
+ */
+void concurrent_arena_trim(void *context);
+/**
+ * @brief Get the total allocated memory from the concurrent arena, summed over all threads
+ *
+ * @param context concurrent arena to get the allocated memory from, is a void* to statify the Allocator interface
+ * @return size_t total allocated memory
+ */
+size_t concurrent_arena_allocated(void *context);
+
+#endif // _CONCURRENT_ARENA_H
@@ -0,0 +1,130 @@
+#include "frame_arena.h"
+
+#include <errno.h>
+#include <memory.h>
+#include <sched.h>
+
+/**
+ * @brief Get the arena of the tick being produced
+ *
+ * @param f frame arena to get the arena from
+ * @return Arena* arena of the current tick
+ */
+static inline Arena *frame_arena_current(FrameArena *f);
+/**
+ * @brief Check whether a pointer belongs to an arena
+ *
+ * @param a arena to check
+ * @param ptr pointer to check
+ * @return int non-zero if the pointer is inside the buffer of the arena
+ */
+static inline int frame_arena_owns(Arena *a, void *ptr);
+
+int frame_arena_init(FrameArena *f, const Arena *frames, size_t count) {
+    if (count < 2 || count > FRAME_ARENA_MAX_FRAMES) {
+        return EINVAL;
+    }
+
+    memset(f, 0, sizeof(*f));
+    memcpy(f->frames, frames, count * sizeof(Arena));
+    f->count = count;
+    return 0;
+}
+
+void frame_arena_destroy(FrameArena *f) {
+    for (size_t i = 0; i < f->count; i++) {
+        arena_destroy(&f->frames[i]);
+    }
+    f->count = 0;
+}
+
+size_t frame_arena_advance(FrameArena *f) {
+    size_t epoch = f->epoch + 1;
+
+    // readers entering from now on read the tick just completed, the ones already in are seen by the scan below
+    __atomic_store_n(&f->epoch, epoch, __ATOMIC_SEQ_CST);
+
+    if (epoch >= f->count) {
+        // readers of the tick held by the arena entered the epoch after it, or an older one they never left
+        size_t last = epoch + 1 - f->count;
+        for (size_t i = 0; i < FRAME_ARENA_MAX_READERS; i++) {
+            size_t entered;
+            while ((entered = __atomic_load_n(&f->readers[i].epoch, __ATOMIC_SEQ_CST)) && entered - 1 <= last) {
+                sched_yield();
+            }
+        }
+    }
+
+    arena_free_all(&f->frames[epoch % f->count]);
+    return epoch;
+}
+
+size_t frame_arena_enter(FrameArena *f, size_t reader) {
+    // the epoch is read again once published, the producer may have scanned the readers in between
+    size_t epoch = __atomic_load_n(&f->epoch, __ATOMIC_SEQ_CST);
+    for (;;) {
+        __atomic_store_n(&f->readers[reader].epoch, epoch + 1, __ATOMIC_SEQ_CST);
+        size_t current = __atomic_load_n(&f->epoch, __ATOMIC_SEQ_CST);
+        if (current == epoch) {
+            return epoch;
+        }
+        epoch = current;
+    }
+}
+
+void frame_arena_leave(FrameArena *f, size_t reader) {
+    __atomic_store_n(&f->readers[reader].epoch, 0, __ATOMIC_RELEASE);
+}
+
+void *frame_arena_alloc(size_t size, void *context) {
+    FrameArena *f = (FrameArena *)context;
+    return arena_alloc(size, frame_arena_current(f));
+}
+
+void *frame_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    FrameArena *f = (FrameArena *)context;
+    Arena *a = frame_arena_current(f);
+    if (!ptr || frame_arena_owns(a, ptr)) {
+        return arena_realloc(new_size, old_size, ptr, a);
+    }
+
+    // memory of a previous tick may still be read, it is copied and left to its arena
+    void *new_ptr = arena_alloc(new_size, a);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, new_size < old_size ? new_size : old_size);
+    }
+    return new_ptr;
+}
+
+void *frame_arena_calloc(size_t count, size_t size, void *context) {
+    FrameArena *f = (FrameArena *)context;
+    return arena_calloc(count, size, frame_arena_current(f));
+}
+
+void *frame_arena_alloc_aligned(size_t size, size_t align, void *context) {
+    FrameArena *f = (FrameArena *)context;
+    return arena_alloc_aligned_ex(size, align, frame_arena_current(f));
+}
+
+void frame_arena_free(size_t size, void *ptr, void *context) {
+    FrameArena *f = (FrameArena *)context;
+    Arena *a = frame_arena_current(f);
+    if (ptr && frame_arena_owns(a, ptr)) {
+        arena_free(size, ptr, a);
+    }
+}
+
+size_t frame_arena_allocated(void *context) {
+    FrameArena *f = (FrameArena *)context;
+    size_t total = 0;
+    for (size_t i = 0; i < f->count; i++) {
+        total += arena_allocated(&f->frames[i]);
+    }
+    return total;
+}
+
+static inline Arena *frame_arena_current(FrameArena *f) { return &f->frames[f->epoch % f->count]; }
+
+static inline int frame_arena_owns(Arena *a, void *ptr) {
+    return (uintptr_t)ptr >= (uintptr_t)a->base && (uintptr_t)ptr < (uintptr_t)a->base + a->size;
+}
@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+
+#include "numa_arena.h"
+
+#include <errno.h>
+#include <memory.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Discover the online nodes of the system
+ *
+ * @param node_ids system id of each node
+ * @return size_t number of nodes, a single node 0 when the topology cannot be read
+ */
+static size_t numa_arena_discover(int *node_ids);
+/**
+ * @brief Map the CPUs of each node of a NUMA arena to the index of their node
+ *
+ * @param n NUMA arena to fill, CPUs of no node keep the first one
+ */
+static void numa_arena_map_cpus(NumaArena *n);
+/**
+ * @brief Bind the memory of an arena to a node
+ *
+ * @param a arena to bind
+ * @param node system id of the node
+ * @return int non-zero if the memory policy was set
+ */
+static int numa_arena_bind(Arena *a, int node);
+/**
+ * @brief Get the arena owning a pointer
+ *
+ * @param n NUMA arena to search
+ * @param ptr pointer allocated from one of the arenas
+ * @return ConcurrentArena* arena of the node the pointer belongs to, the first one if none matches
+ */
+static ConcurrentArena *numa_arena_owner(NumaArena *n, void *ptr);
+/**
+ * @brief Read a list of ids in the "0-3,8,10-11" format of sysfs
+ *
+ * @param path path of the file to read
+ * @param ids ids read, in increasing order
+ * @param max maximum number of ids to read
+ * @return size_t number of ids read, 0 if the file cannot be read
+ */
+static size_t read_id_list(const char *path, int *ids, size_t max);
+
+int numa_arena_init(NumaArena *n, size_t reserve, size_t commit_chunk, size_t align, AllocationStrategy strategy) {
+    int node_ids[NUMA_MAX_NODES];
+    size_t nodes = numa_arena_discover(node_ids);
+    return numa_arena_init_nodes(n, node_ids, nodes, reserve, commit_chunk, align, strategy);
+}
+
+int numa_arena_init_nodes(NumaArena *n, const int *node_ids, size_t nodes, size_t reserve, size_t commit_chunk,
+                          size_t align, AllocationStrategy strategy) {
+    if (!nodes || nodes > NUMA_MAX_NODES) {
+        return EINVAL;
+    }
+    memset(n, 0, sizeof(*n));
+    memcpy(n->node_ids, node_ids, nodes * sizeof(int));
+    n->nodes = nodes;
+    numa_arena_map_cpus(n);
+
+    // the concurrent arenas are aligned to a cache line, which calloc does not guarantee
+    n->arenas = aligned_alloc(_Alignof(ConcurrentArena), n->nodes * sizeof(ConcurrentArena));
+    if (!n->arenas) {
+        return ENOMEM;
+    }
+
+    n->bound = 1;
+    for (size_t i = 0; i < n->nodes; i++) {
+        Arena arena = arena_init_virtual(reserve, commit_chunk, align, strategy);
+        if (!arena.base) {
+            n->nodes = i;
+            numa_arena_destroy(n);
+            return ENOMEM;
+        }
+
+        // the policy set on the reserved range applies to the pages committed later on, without it the arenas of the
+        // nodes would not differ and the set collapses to this single arena
+        if (!numa_arena_bind(&arena, n->node_ids[i])) {
+            n->bound = 0;
+            for (size_t j = 0; j < i; j++) {
+                concurrent_arena_destroy(&n->arenas[j]);
+            }
+            n->nodes = 1;
+            memset(n->cpu_node, 0, sizeof(n->cpu_node));
+            i = 0;
+        }
+
+        int err = concurrent_arena_init(&n->arenas[i], arena);
+        if (err) {
+            arena_destroy(&arena);
+            n->nodes = i;
+            numa_arena_destroy(n);
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+void numa_arena_destroy(NumaArena *n) {
+    for (size_t i = 0; i < n->nodes; i++) {
+        concurrent_arena_destroy(&n->arenas[i]);
+    }
+    free(n->arenas);
+    n->arenas = 0;
+    n->nodes = 0;
+}
+
+size_t numa_arena_current_node(NumaArena *n) {
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu < NUMA_MAX_CPUS) {
+        return n->cpu_node[cpu];
+    }
+#else
+    (void)n;
+#endif
+    return 0;
+}
+
+void *numa_arena_alloc(size_t size, void *context) {
+    NumaArena *n = (NumaArena *)context;
+    return concurrent_arena_alloc(size, &n->arenas[numa_arena_current_node(n)]);
+}
+
+void *numa_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    NumaArena *n = (NumaArena *)context;
+    if (!ptr) {
+        return numa_arena_alloc(new_size, context);
+    }
+    return concurrent_arena_realloc(new_size, old_size, ptr, numa_arena_owner(n, ptr));
+}
+
+void *numa_arena_calloc(size_t count, size_t size, void *context) {
+    NumaArena *n = (NumaArena *)context;
+    return concurrent_arena_calloc(count, size, &n->arenas[numa_arena_current_node(n)]);
+}
+
+void *numa_arena_alloc_aligned(size_t size, size_t align, void *context) {
+    NumaArena *n = (NumaArena *)context;
+    return concurrent_arena_alloc_aligned(size, align, &n->arenas[numa_arena_current_node(n)]);
+}
+
+void numa_arena_free(size_t size, void *ptr, void *context) {
+    NumaArena *n = (NumaArena *)context;
+    if (!ptr) {
+        return;
+    }
+    concurrent_arena_free(size, ptr, numa_arena_owner(n, ptr));
+}
+
+void numa_arena_flush(void *context) {
+    NumaArena *n = (NumaArena *)context;
+    for (size_t i = 0; i < n->nodes; i++) {
+        concurrent_arena_flush(&n->arenas[i]);
+    }
+}
+
+size_t numa_arena_allocated(void *context) {
+    NumaArena *n = (NumaArena *)context;
+    size_t total = 0;
+    for (size_t i = 0; i < n->nodes; i++) {
+        total += concurrent_arena_allocated(&n->arenas[i]);
+    }
+    return total;
+}
+
+static size_t numa_arena_discover(int *node_ids) {
+#ifdef __linux__
+    size_t nodes = read_id_list("/sys/devices/system/node/online", node_ids, NUMA_MAX_NODES);
+    if (nodes) {
+        return nodes;
+    }
+#endif
+    node_ids[0] = 0;
+    return 1;
+}
+
+static void numa_arena_map_cpus(NumaArena *n) {
+#ifdef __linux__
+    int *cpus = malloc(NUMA_MAX_CPUS * sizeof(int));
+    if (!cpus) {
+        return;
+    }
+    for (size_t i = 0; i < n->nodes; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n->node_ids[i]);
+        size_t count = read_id_list(path, cpus, NUMA_MAX_CPUS);
+        for (size_t c = 0; c < count; c++) {
+            if (cpus[c] >= 0 && cpus[c] < NUMA_MAX_CPUS) {
+                n->cpu_node[cpus[c]] = (uint8_t)i;
+            }
+        }
+    }
+    free(cpus);
+#else
+    (void)n;
+#endif
+}
+
+static int numa_arena_bind(Arena *a, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node < 0 || node >= NUMA_MAX_NODES) {
+        return 0;
+    }
+    unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long)) + 1] = {0};
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    return !syscall(SYS_mbind, a->base, a->size, MPOL_BIND, mask, 8 * sizeof(mask), 0);
+#else
+    (void)a;
+    (void)node;
+    return 0;
+#endif
+}
+
+static ConcurrentArena *numa_arena_owner(NumaArena *n, void *ptr) {
+    for (size_t i = 0; i < n->nodes; i++) {
+        Arena *a = &n->arenas[i].arena;
+        if ((uintptr_t)ptr >= (uintptr_t)a->base && (uintptr_t)ptr < (uintptr_t)a->base + a->size) {
+            return &n->arenas[i];
+        }
+    }
+    return &n->arenas[0];
+}
+
+static size_t read_id_list(const char *path, int *ids, size_t max) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return 0;
+    }
+
+    size_t count = 0;
+    int first, last;
+    char sep;
+    while (count < max && fscanf(file, "%d", &first) == 1) {
+        last = first;
+        sep = (char)fgetc(file);
+        if (sep == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            sep = (char)fgetc(file);
+        }
+        for (int id = first; id <= last && count < max; id++) {
+            ids[count++] = id;
+        }
+        if (sep != ',') {
+            break;
+        }
+    }
+
+    fclose(file);
+    return count;
+}
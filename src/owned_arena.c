@@ -0,0 +1,137 @@
+#include "owned_arena.h"
+
+#include <errno.h>
+
+/**
+ * @brief Get the size a block takes in the arena, big enough to be pushed on the remote stack
+ *
+ * @param size requested size
+ * @return size_t size allocated from and freed to the arena
+ */
+static inline size_t owned_size(size_t size);
+/**
+ * @brief Check whether the calling thread owns the arena
+ *
+ * @param o owned arena to check
+ * @return int non-zero if the calling thread is the owner
+ */
+static inline int owned_arena_is_owner(OwnedArena *o);
+
+int owned_arena_init(OwnedArena *o, Arena *arena) {
+    // remote frees store a RemoteBlock at the start of the block, a smaller alignment would misalign it
+    if (arena->align < _Alignof(RemoteBlock)) {
+        return EINVAL;
+    }
+
+    *o = (OwnedArena){
+        .arena = arena,
+        .owner = pthread_self(),
+        .remote = 0,
+        .committed = 0,
+    };
+    return 0;
+}
+
+void owned_arena_adopt(OwnedArena *o) {
+    // other threads read the owner on every free, it is never read half written
+    pthread_t self = pthread_self();
+    __atomic_store(&o->owner, &self, __ATOMIC_RELEASE);
+    owned_arena_drain(o);
+}
+
+void *owned_arena_alloc(size_t size, void *context) {
+    OwnedArena *o = (OwnedArena *)context;
+    owned_arena_drain(o);
+
+    void *ptr = arena_alloc(owned_size(size), o->arena);
+    if (ptr) {
+        __atomic_fetch_add(&o->committed, size, __ATOMIC_RELAXED);
+    }
+    return ptr;
+}
+
+void *owned_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    OwnedArena *o = (OwnedArena *)context;
+    if (!ptr) {
+        return owned_arena_alloc(new_size, context);
+    }
+    // like realloc, a size of zero frees the block and nothing is left to point to
+    if (!new_size) {
+        owned_arena_free(old_size, ptr, context);
+        return 0;
+    }
+    owned_arena_drain(o);
+
+    void *new_ptr = arena_realloc(owned_size(new_size), owned_size(old_size), ptr, o->arena);
+    if (new_ptr) {
+        __atomic_fetch_add(&o->committed, new_size - old_size, __ATOMIC_RELAXED);
+    }
+    return new_ptr;
+}
+
+void *owned_arena_calloc(size_t count, size_t size, void *context) {
+    OwnedArena *o = (OwnedArena *)context;
+    owned_arena_drain(o);
+
+    size_t total_size = count * size;
+    void *ptr = arena_calloc(1, owned_size(total_size), o->arena);
+    if (ptr) {
+        __atomic_fetch_add(&o->committed, total_size, __ATOMIC_RELAXED);
+    }
+    return ptr;
+}
+
+void *owned_arena_alloc_aligned(size_t size, size_t align, void *context) {
+    OwnedArena *o = (OwnedArena *)context;
+    owned_arena_drain(o);
+
+    void *ptr = arena_alloc_aligned_ex(owned_size(size), align, o->arena);
+    if (ptr) {
+        __atomic_fetch_add(&o->committed, size, __ATOMIC_RELAXED);
+    }
+    return ptr;
+}
+
+void owned_arena_free(size_t size, void *ptr, void *context) {
+    OwnedArena *o = (OwnedArena *)context;
+    if (!ptr) {
+        return;
+    }
+
+    __atomic_fetch_sub(&o->committed, size, __ATOMIC_RELAXED);
+    if (owned_arena_is_owner(o)) {
+        arena_free(owned_size(size), ptr, o->arena);
+        return;
+    }
+
+    // the owner takes the whole stack at once, a block is never popped alone so the head cannot come back as ABA
+    RemoteBlock *block = (RemoteBlock *)ptr;
+    block->size = owned_size(size);
+    block->next = __atomic_load_n(&o->remote, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&o->remote, &block->next, block, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+}
+
+size_t owned_arena_drain(OwnedArena *o) {
+    if (!__atomic_load_n(&o->remote, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    size_t count = 0;
+    RemoteBlock *block = __atomic_exchange_n(&o->remote, 0, __ATOMIC_ACQUIRE);
+    while (block) {
+        RemoteBlock *next = block->next;
+        arena_free(block->size, block, o->arena);
+        block = next;
+        count++;
+    }
+    return count;
+}
+
+static inline size_t owned_size(size_t size) { return size < sizeof(RemoteBlock) ? sizeof(RemoteBlock) : size; }
+
+static inline int owned_arena_is_owner(OwnedArena *o) {
+    pthread_t owner;
+    __atomic_load(&o->owner, &owner, __ATOMIC_ACQUIRE);
+    return pthread_equal(owner, pthread_self());
+}
@@ -0,0 +1,122 @@
+#ifndef _OWNED_ARENA_H
+#define _OWNED_ARENA_H
+
+#include "arena.h"
+#include <pthread.h>
+
+/**
+ * @brief Block freed by a foreign thread, stored inside the block itself until its owner drains it
+ *
+ * @param next pointer to the next remote block
+ * @param size size the block was freed with
+ */
+typedef struct RemoteBlock {
+    struct RemoteBlock *next;
+    size_t size;
+} RemoteBlock;
+
+/**
+ * @brief Arena owned by a thread, any thread may free its memory without locking
+ *
+ * Only the owner allocates and frees to the arena. Other threads push their frees on a lock-free stack of remote
+ * blocks, the owner takes the whole stack at once on its next allocation and frees it to the arena. Sizes are rounded
+ * up to sizeof(RemoteBlock) and the arena must be aligned at least like a RemoteBlock, so that every block can be
+ * pushed. The owned arena must not be moved or copied while other threads hold its memory.
+ *
+ * @param arena arena the memory is allocated from, only used by the owner
+ * @param owner thread owning the arena, read by every free so it is stored and loaded atomically
+ * @param remote stack of the blocks freed by other threads, pushed with a compare and swap
+ * @param committed amount of memory committed in the owned arena, remote frees included
+ */
+typedef struct {
+    Arena *arena;
+    pthread_t owner;
+    RemoteBlock *remote;
+    size_t committed;
+} OwnedArena;
+
+/**
+ * @brief Initialize an allocator with an owned arena
+ */
+#define owned_arena_alloc_init(o)                                                                                      \
+    (Allocator) {                                                                                                      \
+        owned_arena_alloc, owned_arena_free, owned_arena_realloc, owned_arena_calloc, owned_arena_allocated, o,        \
+            owned_arena_alloc_aligned                                                                                  \
+    }
+
+/**
+ * @brief Initialize an arena owned by the calling thread
+ *
+ * @param o owned arena to initialize
+ * @param arena arena to allocate from, only the owner may use it afterwards
+ * @return int 0 on success, EINVAL if the arena is aligned below _Alignof(RemoteBlock)
+ */
+int owned_arena_init(OwnedArena *o, Arena *arena);
+/**
+ * @brief Hand the arena over to the calling thread, the previous owner must not use it anymore
+ *
+ * @param o owned arena to take over
+ */
+void owned_arena_adopt(OwnedArena *o);
+/**
+ * @brief Allocate memory, only from the owner, after draining the remote frees
+ *
+ * @param size size of the memory to allocate
+ * @param context owned arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *owned_arena_alloc(size_t size, void *context);
+/**
+ * @brief Reallocate memory, only from the owner
+ *
+ * @param new_size new size of the memory to allocate
+ * @param old_size old size of the memory to reallocate
+ * @param ptr pointer to the memory to reallocate
+ * @param context owned arena to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory
+ */
+void *owned_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Allocate memory and set it to zero, only from the owner
+ *
+ * @param count number of elements to allocate
+ * @param size size of each element
+ * @param context owned arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *owned_arena_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Allocate memory aligned to the given boundary, only from the owner
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2
+ * @param context owned arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *owned_arena_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Free memory from any thread, the owner frees it to the arena, other threads push it on the remote stack
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context owned arena to free from, is a void* to statify the Allocator interface
+ */
+void owned_arena_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Free the blocks pushed by other threads to the arena, only from the owner
+ *
+ * @param o owned arena to drain
+ * @return size_t number of blocks freed
+ */
+size_t owned_arena_drain(OwnedArena *o);
+/**
+ * @brief Get the total allocated memory from the owned arena, blocks freed by other threads are not counted
+ *
+ * @param context owned arena to get the allocated memory from, is a void* to statify the Allocator interface
+ * @return size_t total allocated memory
+ */
+static inline size_t owned_arena_allocated(void *context) {
+    return __atomic_load_n(&((OwnedArena *)context)->committed, __ATOMIC_RELAXED);
+}
+
+#endif // _OWNED_ARENA_H
@@ -0,0 +1,109 @@
+#include "pool.h"
+
+#include <memory.h>
+
+/**
+ * @brief Carve a new slab from the arena of the pool
+ *
+ * @param p pool to grow
+ * @return int non-zero if the slab was carved
+ */
+static int pool_grow(Pool *p);
+
+Pool pool_init(Arena *arena, size_t slot_size, size_t slab_slots) {
+    if (slot_size < sizeof(PoolSlot)) {
+        slot_size = sizeof(PoolSlot);
+    }
+    // every slot keeps the alignment of the arena
+    slot_size = (slot_size + arena->align - 1) & ~(arena->align - 1);
+
+    return (Pool){
+        .arena = arena,
+        .slot_size = slot_size,
+        .slab_slots = slab_slots ? slab_slots : DEFAULT_POOL_SLAB_SLOTS,
+        .free = 0,
+        .cursor = 0,
+        .end = 0,
+        .committed = 0,
+    };
+}
+
+void *pool_alloc(size_t size, void *context) {
+    Pool *p = (Pool *)context;
+    if (!size || size > p->slot_size) {
+        return 0;
+    }
+
+    void *ptr = 0;
+    if (p->free) {
+        ptr = (void *)p->free;
+        p->free = p->free->next;
+    } else if (p->cursor != p->end || pool_grow(p)) {
+        ptr = (void *)p->cursor;
+        p->cursor += p->slot_size;
+    } else {
+        return 0;
+    }
+
+    p->committed += size;
+    return ptr;
+}
+
+void *pool_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    Pool *p = (Pool *)context;
+    if (!ptr) {
+        return pool_alloc(new_size, context);
+    }
+    // like realloc, a size of zero frees the block and nothing is left to point to
+    if (!new_size) {
+        pool_free(old_size, ptr, context);
+        return 0;
+    }
+    if (new_size > p->slot_size) {
+        return 0;
+    }
+
+    p->committed += new_size - old_size;
+    return ptr;
+}
+
+void *pool_calloc(size_t count, size_t size, void *context) {
+    size_t total_size = count * size;
+    void *ptr = pool_alloc(total_size, context);
+    if (ptr) {
+        memset(ptr, 0, total_size);
+    }
+    return ptr;
+}
+
+void *pool_alloc_aligned(size_t size, size_t align, void *context) {
+    Pool *p = (Pool *)context;
+    if (align > p->arena->align) {
+        return 0;
+    }
+    return pool_alloc(size, context);
+}
+
+void pool_free(size_t size, void *ptr, void *context) {
+    Pool *p = (Pool *)context;
+    if (!ptr) {
+        return;
+    }
+
+    PoolSlot *slot = (PoolSlot *)ptr;
+    slot->next = p->free;
+    p->free = slot;
+    p->committed -= size;
+}
+
+static int pool_grow(Pool *p) {
+    size_t size = p->slot_size * p->slab_slots;
+    uint8_t *slab = arena_alloc(size, p->arena);
+    if (!slab) {
+        return 0;
+    }
+
+    p->cursor = slab;
+    p->end = slab + size;
+    return 1;
+}
@@ -0,0 +1,108 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+#include "arena.h"
+
+// Default number of slots carved at once from the arena
+#define DEFAULT_POOL_SLAB_SLOTS 64
+
+/**
+ * @brief Free slot of a pool, stored inside the slot itself
+ *
+ * @param next pointer to the next free slot
+ */
+typedef struct PoolSlot {
+    struct PoolSlot *next;
+} PoolSlot;
+
+/**
+ * @brief Pool of fixed-size slots carved in slabs from an arena
+ *
+ * @param arena arena the slabs are carved from
+ * @param slot_size size of each slot, a multiple of the arena alignment
+ * @param slab_slots number of slots of each slab
+ * @param free stack of freed slots
+ * @param cursor next never used slot of the current slab
+ * @param end end of the current slab
+ * @param committed amount of memory committed in the pool
+ */
+typedef struct {
+    Arena *arena;
+    size_t slot_size;
+    size_t slab_slots;
+    PoolSlot *free;
+    uint8_t *cursor;
+    uint8_t *end;
+    size_t committed;
+} Pool;
+
+/**
+ * @brief Initialize an allocator with a pool
+ */
+#define pool_alloc_init(p)                                                                                             \
+    (Allocator) { pool_alloc, pool_free, pool_realloc, pool_calloc, pool_allocated, p, pool_alloc_aligned }
+
+/**
+ * @brief Initialize a pool of slots of the same size
+ *
+ * @param arena arena to carve the slabs from
+ * @param slot_size size of each slot, requests up to this size are served
+ * @param slab_slots number of slots carved at once, use DEFAULT_POOL_SLAB_SLOTS for default
+ * @return Pool
+ */
+Pool pool_init(Arena *arena, size_t slot_size, size_t slab_slots);
+/**
+ * @brief Allocate a slot from the pool
+ *
+ * @param size size of the memory to allocate, at most the slot size
+ * @param context pool to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory, null if the size exceeds the slot size or the arena is full
+ */
+void *pool_alloc(size_t size, void *context);
+/**
+ * @brief Reallocate a slot from the pool, the memory never moves
+ *
+ * @param new_size new size of the memory to allocate, at most the slot size
+ * @param old_size old size of the memory to reallocate
+ * @param ptr pointer to the memory to reallocate
+ * @param context pool to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory, null if the new size exceeds the slot size
+ */
+void *pool_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Allocate a slot from the pool and set it to zero
+ *
+ * @param count number of elements to allocate
+ * @param size size of each element
+ * @param context pool to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *pool_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Allocate a slot from the pool aligned to the given boundary
+ *
+ * Slots are aligned to the arena alignment, bigger alignments are not served.
+ *
+ * @param size size of the memory to allocate, at most the slot size
+ * @param align alignment of the memory, at most the arena alignment
+ * @param context pool to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory, null if the alignment or the size cannot be served
+ */
+void *pool_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Give a slot back to the pool
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context pool to free from, is a void* to statify the Allocator interface
+ */
+void pool_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Get the total allocated memory from the pool
+ *
+ * @param context pool to get the allocated memory from, is a void* to statify the Allocator interface
+ * @return size_t total allocated memory
+ */
+static inline size_t pool_allocated(void *context) { return ((Pool *)context)->committed; }
+
+#endif // _POOL_H
@@ -0,0 +1,459 @@
+#define _DEFAULT_SOURCE
+
+#include "profile.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+
+// Frames of the profiler itself at the top of a captured stack, the capture, the sampling function or hook of the arena
+// and the allocator entry point
+#define PROFILE_SKIP_FRAMES 3
+
+// Frames captured in case something wraps backtrace, like the interceptor of a sanitizer
+#define PROFILE_EXTRA_FRAMES 2
+
+/**
+ * @brief Account an allocation, capturing its stack when the sampling interval is used up
+ *
+ * Always inlined, even without optimizations, so that it never shows up in a captured stack.
+ *
+ * @param p profiler to update
+ * @param ptr allocated pointer
+ * @param size size of the allocation
+ */
+static inline void profiler_account(HeapProfiler *p, void *ptr, size_t size) __attribute__((always_inline));
+/**
+ * @brief Sample an allocation made through the profiler
+ *
+ * Never inlined, so that its return address is in the allocator entry point.
+ *
+ * @param p profiler to update
+ * @param ptr sampled pointer
+ * @param size size of the allocation
+ */
+static void profiler_sample(HeapProfiler *p, void *ptr, size_t size) __attribute__((noinline));
+/**
+ * @brief Capture the stack of a sampled allocation and record it
+ *
+ * Never inlined, so that the number of frames to skip is known when the entry point is not found.
+ *
+ * @param p profiler to update
+ * @param ptr sampled pointer
+ * @param size size of the allocation
+ * @param entry return address into the allocator entry point, the stack starts with the frame after it
+ */
+static void profiler_capture(HeapProfiler *p, void *ptr, size_t size, void *entry) __attribute__((noinline));
+/**
+ * @brief Move the sample of a reallocated block, counting the bytes it grows by towards the next sample
+ *
+ * @param p profiler to update
+ * @param ptr pointer before the reallocation
+ * @param new_ptr pointer after the reallocation
+ * @param old_size size before the reallocation
+ * @param new_size size after the reallocation
+ * @return int 1 if the block must be sampled as a new allocation, 0 otherwise
+ */
+static int profiler_resized(HeapProfiler *p, void *ptr, void *new_ptr, size_t old_size, size_t new_size);
+/**
+ * @brief Hooks of the sampler of a profiled arena, called from the allocator entry points of the arena
+ *
+ * The sample and moved hooks are never inlined, so that their return address is in the entry point.
+ */
+static void profiler_arena_sample(ArenaSampler *sampler, void *ptr, size_t size) __attribute__((noinline));
+static void profiler_arena_forget(ArenaSampler *sampler, void *ptr);
+static void profiler_arena_moved(ArenaSampler *sampler, void *ptr, void *new_ptr, size_t old_size,
+                                 size_t new_size) __attribute__((noinline));
+/**
+ * @brief Draw the number of bytes until the next sample
+ *
+ * @param p profiler to draw from
+ * @return size_t bytes to allocate before the next sample, at least 1
+ */
+static size_t profiler_next_interval(HeapProfiler *p);
+/**
+ * @brief Find the stack of some frames, adding it if it is new
+ *
+ * @param p profiler to update
+ * @param frames return addresses, innermost first
+ * @param depth number of frames
+ * @return ProfileStack* stack of the frames, null if it cannot be allocated
+ */
+static ProfileStack *profiler_stack(HeapProfiler *p, void **frames, size_t depth);
+/**
+ * @brief Insert a live sampled pointer, growing the table when half full
+ *
+ * @param p profiler to update
+ * @param slot pointer, stack and size to insert
+ */
+static void profiler_live_put(HeapProfiler *p, ProfileSlot slot);
+/**
+ * @brief Remove a live sampled pointer and take it out of the in-use profile
+ *
+ * @param p profiler to update
+ * @param ptr pointer to remove
+ * @return ProfileSlot removed slot, with a null pointer if the pointer was not sampled
+ */
+static ProfileSlot profiler_live_take(HeapProfiler *p, void *ptr);
+/**
+ * @brief Get the home slot of a pointer in the table of live pointers
+ *
+ * @param ptr pointer to hash
+ * @param capacity number of slots of the table, a power of 2
+ * @return size_t index of the slot
+ */
+static inline size_t profile_hash(void *ptr, size_t capacity);
+
+int profiler_init(HeapProfiler *p, Allocator inner, size_t rate) {
+    *p = (HeapProfiler){0};
+    p->inner = inner;
+    p->rate = rate ? rate : PROFILE_DEFAULT_RATE;
+    p->seed = 0x9e3779b97f4a7c15u ^ (uint64_t)(uintptr_t)p;
+
+    p->stacks = calloc(PROFILE_INITIAL_SLOTS, sizeof(ProfileStack *));
+    p->live = calloc(PROFILE_INITIAL_SLOTS, sizeof(ProfileSlot));
+    if (!p->stacks || !p->live) {
+        free(p->stacks);
+        free(p->live);
+        *p = (HeapProfiler){0};
+        return -1;
+    }
+    p->stack_capacity = PROFILE_INITIAL_SLOTS;
+    p->live_capacity = PROFILE_INITIAL_SLOTS;
+    p->sampler.until_sample = profiler_next_interval(p);
+    return 0;
+}
+
+int profiler_init_arena(HeapProfiler *p, Arena *a, size_t rate) {
+    if (profiler_init(p, arena_alloc_init(a), rate)) {
+        return -1;
+    }
+    p->sampler.sample = profiler_arena_sample;
+    p->sampler.forget = profiler_arena_forget;
+    p->sampler.moved = profiler_arena_moved;
+    p->arena = a;
+    arena_set_sampler(a, &p->sampler);
+    return 0;
+}
+
+void profiler_destroy(HeapProfiler *p) {
+    if (p->arena) {
+        arena_set_sampler(p->arena, 0);
+    }
+    for (size_t i = 0; i < p->stack_capacity; i++) {
+        free(p->stacks[i]);
+    }
+    free(p->stacks);
+    free(p->live);
+    *p = (HeapProfiler){0};
+}
+
+void *profiler_alloc(size_t size, void *context) {
+    HeapProfiler *p = (HeapProfiler *)context;
+    void *ptr = p->inner.alloc(size, p->inner.context);
+    if (ptr) {
+        profiler_account(p, ptr, size);
+    }
+    return ptr;
+}
+
+void *profiler_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    HeapProfiler *p = (HeapProfiler *)context;
+    // a size of zero frees the block, its sample goes with it
+    if (ptr && !new_size) {
+        profiler_free(old_size, ptr, context);
+        return 0;
+    }
+    void *new_ptr = p->inner.realloc(new_size, old_size, ptr, p->inner.context);
+    if (new_ptr && profiler_resized(p, ptr, new_ptr, old_size, new_size)) {
+        profiler_sample(p, new_ptr, new_size);
+    }
+    return new_ptr;
+}
+
+void *profiler_calloc(size_t count, size_t size, void *context) {
+    HeapProfiler *p = (HeapProfiler *)context;
+    void *ptr = p->inner.calloc(count, size, p->inner.context);
+    if (ptr) {
+        profiler_account(p, ptr, count * size);
+    }
+    return ptr;
+}
+
+void *profiler_alloc_aligned(size_t size, size_t align, void *context) {
+    HeapProfiler *p = (HeapProfiler *)context;
+    void *ptr = p->inner.alloc_aligned(size, align, p->inner.context);
+    if (ptr) {
+        profiler_account(p, ptr, size);
+    }
+    return ptr;
+}
+
+void profiler_free(size_t size, void *ptr, void *context) {
+    HeapProfiler *p = (HeapProfiler *)context;
+    if (ptr && p->sampler.live) {
+        profiler_live_take(p, ptr);
+    }
+    p->inner.free(size, ptr, p->inner.context);
+}
+
+int profiler_write(HeapProfiler *p, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return -1;
+    }
+
+    uint64_t totals[4] = {0};
+    for (size_t i = 0; i < p->stack_capacity; i++) {
+        ProfileStack *stack = p->stacks[i];
+        if (stack) {
+            totals[0] += stack->inuse_objects;
+            totals[1] += stack->inuse_bytes;
+            totals[2] += stack->alloc_objects;
+            totals[3] += stack->alloc_bytes;
+        }
+    }
+
+    fprintf(file, "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%zu\n", (unsigned long long)totals[0],
+            (unsigned long long)totals[1], (unsigned long long)totals[2], (unsigned long long)totals[3], p->rate);
+    for (size_t i = 0; i < p->stack_capacity; i++) {
+        ProfileStack *stack = p->stacks[i];
+        if (!stack) {
+            continue;
+        }
+        fprintf(file, "%llu: %llu [%llu: %llu] @", (unsigned long long)stack->inuse_objects,
+                (unsigned long long)stack->inuse_bytes, (unsigned long long)stack->alloc_objects,
+                (unsigned long long)stack->alloc_bytes);
+        for (size_t f = 0; f < stack->depth; f++) {
+            fprintf(file, " %p", stack->frames[f]);
+        }
+        fputc('\n', file);
+    }
+
+    // pprof maps the addresses back to the binaries loaded by the process
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps) {
+        fprintf(file, "\nMAPPED_LIBRARIES:\n");
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), maps)) > 0) {
+            fwrite(buffer, 1, read, file);
+        }
+        fclose(maps);
+    }
+
+    return fclose(file) ? -1 : 0;
+}
+
+static inline void profiler_account(HeapProfiler *p, void *ptr, size_t size) {
+    if (size < p->sampler.until_sample) {
+        p->sampler.until_sample -= size;
+        return;
+    }
+    profiler_sample(p, ptr, size);
+}
+
+static void profiler_sample(HeapProfiler *p, void *ptr, size_t size) {
+    profiler_capture(p, ptr, size, __builtin_return_address(0));
+}
+
+static void profiler_capture(HeapProfiler *p, void *ptr, size_t size, void *entry) {
+    // exponential intervals sample an allocation of size bytes with a probability of 1 - exp(-size / rate)
+    p->sampler.until_sample = profiler_next_interval(p);
+
+    void *frames[PROFILE_MAX_DEPTH + PROFILE_SKIP_FRAMES + PROFILE_EXTRA_FRAMES];
+    size_t skip = 0;
+    size_t depth = 0;
+#if defined(__GLIBC__)
+    int captured = backtrace(frames, PROFILE_MAX_DEPTH + PROFILE_SKIP_FRAMES + PROFILE_EXTRA_FRAMES);
+    // the stack starts after the allocator entry point, whatever wraps backtrace
+    skip = PROFILE_SKIP_FRAMES;
+    for (size_t i = 0; i < (size_t)captured && i <= PROFILE_SKIP_FRAMES + PROFILE_EXTRA_FRAMES; i++) {
+        if (frames[i] == entry) {
+            skip = i + 1;
+            break;
+        }
+    }
+    depth = (size_t)captured > skip ? (size_t)captured - skip : 0;
+    depth = depth < PROFILE_MAX_DEPTH ? depth : PROFILE_MAX_DEPTH;
+#endif
+
+    ProfileStack *stack = profiler_stack(p, frames + skip, depth);
+    if (!stack) {
+        return;
+    }
+    stack->alloc_objects++;
+    stack->alloc_bytes += size;
+    stack->inuse_objects++;
+    stack->inuse_bytes += size;
+
+    // a pointer still in the table was freed behind the back of the profiler, by a reset of the inner allocator
+    if (p->sampler.live) {
+        profiler_live_take(p, ptr);
+    }
+    profiler_live_put(p, (ProfileSlot){ptr, stack, size});
+}
+
+static int profiler_resized(HeapProfiler *p, void *ptr, void *new_ptr, size_t old_size, size_t new_size) {
+    // a sampled block keeps its sample, only the bytes it grows by count towards the next one
+    ProfileSlot sampled = {0};
+    if (ptr && p->sampler.live) {
+        sampled = profiler_live_take(p, ptr);
+    }
+    size_t grown = new_size > old_size ? new_size - old_size : 0;
+    if (sampled.ptr) {
+        sampled.stack->alloc_bytes += grown;
+        sampled.stack->inuse_objects++;
+        sampled.stack->inuse_bytes += new_size;
+        profiler_live_put(p, (ProfileSlot){new_ptr, sampled.stack, new_size});
+        return 0;
+    }
+    if (grown < p->sampler.until_sample) {
+        p->sampler.until_sample -= grown;
+        return 0;
+    }
+    return 1;
+}
+
+// the sampler is the first member of the profiler, the hooks get back to the profiler with a cast
+static void profiler_arena_sample(ArenaSampler *sampler, void *ptr, size_t size) {
+    profiler_capture((HeapProfiler *)sampler, ptr, size, __builtin_return_address(0));
+}
+
+static void profiler_arena_forget(ArenaSampler *sampler, void *ptr) {
+    profiler_live_take((HeapProfiler *)sampler, ptr);
+}
+
+static void profiler_arena_moved(ArenaSampler *sampler, void *ptr, void *new_ptr, size_t old_size, size_t new_size) {
+    HeapProfiler *p = (HeapProfiler *)sampler;
+    if (profiler_resized(p, ptr, new_ptr, old_size, new_size)) {
+        profiler_capture(p, new_ptr, new_size, __builtin_return_address(0));
+    }
+}
+
+static size_t profiler_next_interval(HeapProfiler *p) {
+    if (p->rate == 1) {
+        return 1;
+    }
+
+    // xorshift64* mapped to (0, 1], the exponential draw keeps the mean at rate
+    p->seed ^= p->seed >> 12;
+    p->seed ^= p->seed << 25;
+    p->seed ^= p->seed >> 27;
+    double u = (double)((p->seed * 0x2545f4914f6cdd1du) >> 11) / 9007199254740992.0;
+    double interval = -log(1.0 - u) * (double)p->rate;
+    return interval < 1.0 ? 1 : interval > (double)(SIZE_MAX / 2) ? SIZE_MAX / 2 : (size_t)interval;
+}
+
+static ProfileStack *profiler_stack(HeapProfiler *p, void **frames, size_t depth) {
+    uint64_t hash = 0xcbf29ce484222325u;
+    for (size_t f = 0; f < depth; f++) {
+        hash = (hash ^ (uint64_t)(uintptr_t)frames[f]) * 0x100000001b3u;
+    }
+
+    size_t mask = p->stack_capacity - 1;
+    size_t i = (size_t)(hash >> 32) & mask;
+    for (ProfileStack *stack; (stack = p->stacks[i]); i = (i + 1) & mask) {
+        if (stack->hash == hash && stack->depth == depth && !memcmp(stack->frames, frames, depth * sizeof(void *))) {
+            return stack;
+        }
+    }
+
+    if (2 * (p->stack_count + 1) > p->stack_capacity) {
+        ProfileStack **stacks = calloc(2 * p->stack_capacity, sizeof(ProfileStack *));
+        if (!stacks) {
+            return 0;
+        }
+        for (size_t j = 0; j < p->stack_capacity; j++) {
+            if (p->stacks[j]) {
+                size_t k = (size_t)(p->stacks[j]->hash >> 32) & (2 * p->stack_capacity - 1);
+                while (stacks[k]) {
+                    k = (k + 1) & (2 * p->stack_capacity - 1);
+                }
+                stacks[k] = p->stacks[j];
+            }
+        }
+        free(p->stacks);
+        p->stacks = stacks;
+        p->stack_capacity *= 2;
+        mask = p->stack_capacity - 1;
+        for (i = (size_t)(hash >> 32) & mask; p->stacks[i]; i = (i + 1) & mask) {
+        }
+    }
+
+    ProfileStack *stack = calloc(1, sizeof(ProfileStack));
+    if (!stack) {
+        return 0;
+    }
+    stack->hash = hash;
+    stack->depth = depth;
+    memcpy(stack->frames, frames, depth * sizeof(void *));
+    p->stacks[i] = stack;
+    p->stack_count++;
+    return stack;
+}
+
+static void profiler_live_put(HeapProfiler *p, ProfileSlot slot) {
+    if (2 * (p->sampler.live + 1) > p->live_capacity) {
+        ProfileSlot *live = calloc(2 * p->live_capacity, sizeof(ProfileSlot));
+        // without a bigger table the sample stays in the in-use profile until the end
+        if (!live) {
+            return;
+        }
+
+        ProfileSlot *old = p->live;
+        size_t capacity = p->live_capacity;
+        p->live = live;
+        p->live_capacity = 2 * capacity;
+        p->sampler.live = 0;
+        for (size_t i = 0; i < capacity; i++) {
+            if (old[i].ptr) {
+                profiler_live_put(p, old[i]);
+            }
+        }
+        free(old);
+    }
+
+    size_t i = profile_hash(slot.ptr, p->live_capacity);
+    while (p->live[i].ptr) {
+        i = (i + 1) & (p->live_capacity - 1);
+    }
+    p->live[i] = slot;
+    p->sampler.live++;
+}
+
+static ProfileSlot profiler_live_take(HeapProfiler *p, void *ptr) {
+    size_t mask = p->live_capacity - 1;
+    size_t i = profile_hash(ptr, p->live_capacity);
+    while (p->live[i].ptr != ptr) {
+        if (!p->live[i].ptr) {
+            return (ProfileSlot){0};
+        }
+        i = (i + 1) & mask;
+    }
+    ProfileSlot slot = p->live[i];
+    p->live[i].stack->inuse_objects--;
+    p->live[i].stack->inuse_bytes -= p->live[i].size;
+    p->sampler.live--;
+
+    // shift the following slots back so that no probe sequence is broken by the hole
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; p->live[j].ptr; j = (j + 1) & mask) {
+        size_t home = profile_hash(p->live[j].ptr, p->live_capacity);
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            p->live[hole] = p->live[j];
+            hole = j;
+        }
+    }
+    p->live[hole] = (ProfileSlot){0};
+    return slot;
+}
+
+static inline size_t profile_hash(void *ptr, size_t capacity) {
+    uint64_t h = (uint64_t)(uintptr_t)ptr * 0x9e3779b97f4a7c15u;
+    return (size_t)(h >> 32) & (capacity - 1);
+}
@@ -0,0 +1,370 @@
+#include "slab.h"
+#include "utils.h"
+
+#include <memory.h>
+
+/**
+ * @brief Check whether a size is served from the slabs
+ *
+ * @param s slab arena to check
+ * @param size requested size
+ * @return int non-zero if the size is served from the slabs
+ */
+static inline int slab_is_small(SlabArena *s, size_t size);
+/**
+ * @brief Get the size class of a small size
+ *
+ * @param s slab arena the size belongs to
+ * @param size requested size, served from the slabs
+ * @return size_t index of the class
+ */
+static inline size_t slab_class(SlabArena *s, size_t size);
+/**
+ * @brief Get the slab a slot belongs to
+ *
+ * @param ptr pointer to the slot
+ * @return Slab* header of the slab
+ */
+static inline Slab *slab_of(void *ptr);
+/**
+ * @brief Get the first slot of a slab
+ *
+ * @param slab header of the slab
+ * @return uint8_t* start of the memory of the slab
+ */
+static inline uint8_t *slab_memory(Slab *slab);
+/**
+ * @brief Take an empty slab, or carve a new one from the arena, and push it in front of the slabs of its class
+ *
+ * @param s slab arena to grow
+ * @param class size class of the slots
+ * @param align alignment of the slab, at least SLAB_SIZE
+ * @return Slab* the new slab, null if the arena is full
+ */
+static Slab *slab_carve(SlabArena *s, size_t class, size_t align);
+/**
+ * @brief Mark a free slot of a slab as used, the slab leaves the list of its class once full
+ *
+ * @param s slab arena the slab belongs to
+ * @param slab slab to take the slot from
+ * @param index index of a free slot
+ * @return void* pointer to the slot
+ */
+static void *slab_take(SlabArena *s, Slab *slab, size_t index);
+/**
+ * @brief Give a slot back to its slab
+ *
+ * @param s slab arena the slab belongs to
+ * @param ptr pointer to the slot
+ */
+static void slab_give(SlabArena *s, void *ptr);
+/**
+ * @brief Remove a slab from the list of its class
+ *
+ * @param s slab arena the slab belongs to
+ * @param slab slab to remove
+ */
+static void slab_unlink(SlabArena *s, Slab *slab);
+/**
+ * @brief Push a slab in front of the list of its class
+ *
+ * @param s slab arena the slab belongs to
+ * @param slab slab to push
+ */
+static void slab_push(SlabArena *s, Slab *slab);
+
+SlabArena slab_arena_init(Arena *arena) {
+    return (SlabArena){
+        .arena = arena,
+        .step = arena->align > SLAB_MIN_SLOT ? arena->align : SLAB_MIN_SLOT,
+        .partial = {0},
+        .empty = 0,
+        .committed = 0,
+    };
+}
+
+void *slab_arena_alloc(size_t size, void *context) {
+    SlabArena *s = (SlabArena *)context;
+    if (!slab_is_small(s, size)) {
+        void *ptr = arena_alloc(size, s->arena);
+        if (ptr) {
+            s->committed += size;
+        }
+        return ptr;
+    }
+
+    size_t class = slab_class(s, size);
+    Slab *slab = s->partial[class];
+    if (!slab && !(slab = slab_carve(s, class, SLAB_SIZE))) {
+        return 0;
+    }
+
+    // a slab in the list has at least one free slot
+    size_t word = 0;
+    while (!slab->free[word]) {
+        word++;
+    }
+    s->committed += size;
+    return slab_take(s, slab, word * 64 + (size_t)__builtin_ctzll(slab->free[word]));
+}
+
+void *slab_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    SlabArena *s = (SlabArena *)context;
+    if (!ptr) {
+        return slab_arena_alloc(new_size, context);
+    }
+    // like realloc, a size of zero frees the block and nothing is left to point to
+    if (!new_size) {
+        slab_arena_free(old_size, ptr, context);
+        return 0;
+    }
+
+    int was_small = slab_is_small(s, old_size);
+    int is_small = slab_is_small(s, new_size);
+    if (!was_small && !is_small) {
+        void *new_ptr = arena_realloc(new_size, old_size, ptr, s->arena);
+        if (new_ptr) {
+            s->committed += new_size - old_size;
+        }
+        return new_ptr;
+    }
+    if (was_small && is_small && slab_class(s, old_size) == slab_class(s, new_size)) {
+        s->committed += new_size - old_size;
+        return ptr;
+    }
+
+    // the slot size is told by the size given to free, memory changing class has to move
+    void *new_ptr = slab_arena_alloc(new_size, context);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, new_size < old_size ? new_size : old_size);
+        slab_arena_free(old_size, ptr, context);
+    }
+    return new_ptr;
+}
+
+void *slab_arena_calloc(size_t count, size_t size, void *context) {
+    size_t total_size = count * size;
+    void *ptr = slab_arena_alloc(total_size, context);
+    if (ptr) {
+        memset(ptr, 0, total_size);
+    }
+    return ptr;
+}
+
+void *slab_arena_alloc_aligned(size_t size, size_t align, void *context) {
+    SlabArena *s = (SlabArena *)context;
+    if (!is_power_of_two(align)) {
+        return 0;
+    }
+    if (!slab_is_small(s, size)) {
+        void *ptr = arena_alloc_aligned_ex(size, align, s->arena);
+        if (ptr) {
+            s->committed += size;
+        }
+        return ptr;
+    }
+    if (align <= s->step) {
+        return slab_arena_alloc(size, context);
+    }
+
+    // slabs are aligned to SLAB_SIZE, slot i is aligned when i times the slot size is a multiple of the alignment
+    size_t class = slab_class(s, size);
+    size_t slot_size = (class + 1) * SLAB_MIN_SLOT;
+    size_t slot_align = slot_size & (~slot_size + 1);
+    size_t stride = align / (slot_align < align ? slot_align : align);
+
+    if (align <= SLAB_SIZE) {
+        for (Slab *slab = s->partial[class]; slab; slab = slab->next) {
+            for (size_t i = 0; i < slab->slots; i += stride) {
+                if (slab->free[i / 64] & ((uint64_t)1 << (i % 64))) {
+                    s->committed += size;
+                    return slab_take(s, slab, i);
+                }
+            }
+        }
+    }
+
+    // the first slot of a new slab has the alignment of the slab
+    Slab *slab = slab_carve(s, class, align > SLAB_SIZE ? align : SLAB_SIZE);
+    if (!slab) {
+        return 0;
+    }
+    s->committed += size;
+    return slab_take(s, slab, 0);
+}
+
+void slab_arena_free(size_t size, void *ptr, void *context) {
+    SlabArena *s = (SlabArena *)context;
+    if (!ptr) {
+        return;
+    }
+
+    if (slab_is_small(s, size)) {
+        slab_give(s, ptr);
+    } else {
+        arena_free(size, ptr, s->arena);
+    }
+    s->committed -= size;
+}
+
+size_t slab_arena_alloc_batch(size_t count, size_t size, void **out, void *context) {
+    SlabArena *s = (SlabArena *)context;
+    if (!slab_is_small(s, size)) {
+        size_t done = arena_alloc_batch(count, size, out, s->arena);
+        s->committed += done * size;
+        return done;
+    }
+
+    size_t class = slab_class(s, size);
+    size_t done = 0;
+    while (done < count) {
+        Slab *slab = s->partial[class];
+        if (!slab && !(slab = slab_carve(s, class, SLAB_SIZE))) {
+            break;
+        }
+
+        // every free slot of a word is taken before the word is written back
+        uint8_t *memory = slab_memory(slab);
+        for (size_t word = 0; word < SLAB_MAP_WORDS && done < count; word++) {
+            uint64_t bits = slab->free[word];
+            while (bits && done < count) {
+                out[done++] = memory + (word * 64 + (size_t)__builtin_ctzll(bits)) * slab->slot_size;
+                bits &= bits - 1;
+                slab->used++;
+            }
+            slab->free[word] = bits;
+        }
+        if (slab->used == slab->slots) {
+            slab_unlink(s, slab);
+        }
+    }
+
+    s->committed += done * size;
+    return done;
+}
+
+void slab_arena_free_batch(size_t count, size_t size, void **ptrs, void *context) {
+    SlabArena *s = (SlabArena *)context;
+    if (!slab_is_small(s, size)) {
+        size_t freed = 0;
+        for (size_t i = 0; i < count; i++) {
+            freed += ptrs[i] != 0;
+        }
+        arena_free_batch(count, size, ptrs, s->arena);
+        s->committed -= freed * size;
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (ptrs[i]) {
+            slab_give(s, ptrs[i]);
+            s->committed -= size;
+        }
+    }
+}
+
+size_t slab_arena_trim(SlabArena *s) {
+    size_t count = 0;
+    while (s->empty) {
+        Slab *slab = s->empty;
+        s->empty = slab->next;
+        arena_free(SLAB_SIZE, slab_memory(slab), s->arena);
+        count++;
+    }
+    return count;
+}
+
+void slab_arena_free_all(void *context) {
+    SlabArena *s = (SlabArena *)context;
+    arena_free_all(s->arena);
+    memset(s->partial, 0, sizeof(s->partial));
+    s->empty = 0;
+    s->committed = 0;
+}
+
+static inline int slab_is_small(SlabArena *s, size_t size) {
+    return size && size <= SLAB_MAX_SIZE && s->step <= SLAB_MAX_SIZE;
+}
+
+static inline size_t slab_class(SlabArena *s, size_t size) {
+    return ((size + s->step - 1) & ~(s->step - 1)) / SLAB_MIN_SLOT - 1;
+}
+
+static inline Slab *slab_of(void *ptr) {
+    return (Slab *)(((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1)) + SLAB_SIZE - sizeof(Slab));
+}
+
+static inline uint8_t *slab_memory(Slab *slab) { return (uint8_t *)slab + sizeof(Slab) - SLAB_SIZE; }
+
+static Slab *slab_carve(SlabArena *s, size_t class, size_t align) {
+    // the arena would search a block big enough for the worst padding, empty slabs are already aligned
+    uint8_t *memory = 0;
+    if (s->empty && !((uintptr_t)slab_memory(s->empty) & (align - 1))) {
+        memory = slab_memory(s->empty);
+        s->empty = s->empty->next;
+    } else if (!(memory = arena_alloc_aligned_ex(SLAB_SIZE, align, s->arena))) {
+        return 0;
+    }
+
+    Slab *slab = (Slab *)(memory + SLAB_SIZE - sizeof(Slab));
+    slab->slot_size = (uint32_t)((class + 1) * SLAB_MIN_SLOT);
+    slab->slots = (uint32_t)((SLAB_SIZE - sizeof(Slab)) / slab->slot_size);
+    slab->used = 0;
+    for (size_t word = 0; word < SLAB_MAP_WORDS; word++) {
+        size_t first = word * 64;
+        if (first + 64 <= slab->slots) {
+            slab->free[word] = ~(uint64_t)0;
+        } else {
+            slab->free[word] = first < slab->slots ? ((uint64_t)1 << (slab->slots - first)) - 1 : 0;
+        }
+    }
+
+    slab_push(s, slab);
+    return slab;
+}
+
+static void *slab_take(SlabArena *s, Slab *slab, size_t index) {
+    slab->free[index / 64] &= ~((uint64_t)1 << (index % 64));
+    if (++slab->used == slab->slots) {
+        slab_unlink(s, slab);
+    }
+    return slab_memory(slab) + index * slab->slot_size;
+}
+
+static void slab_give(SlabArena *s, void *ptr) {
+    Slab *slab = slab_of(ptr);
+    size_t index = (size_t)((uint8_t *)ptr - slab_memory(slab)) / slab->slot_size;
+    slab->free[index / 64] |= (uint64_t)1 << (index % 64);
+
+    // a full slab has free slots again, an empty one stays in its class only if the class would be left without slabs
+    if (slab->used-- == slab->slots) {
+        slab_push(s, slab);
+    } else if (!slab->used && (slab->prev || slab->next)) {
+        slab_unlink(s, slab);
+        slab->next = s->empty;
+        s->empty = slab;
+    }
+}
+
+static void slab_unlink(SlabArena *s, Slab *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        s->partial[slab->slot_size / SLAB_MIN_SLOT - 1] = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = 0;
+    slab->next = 0;
+}
+
+static void slab_push(SlabArena *s, Slab *slab) {
+    Slab **head = &s->partial[slab->slot_size / SLAB_MIN_SLOT - 1];
+    slab->prev = 0;
+    slab->next = *head;
+    if (*head) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+}
@@ -0,0 +1,166 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "arena.h"
+
+// Size of each slab carved from the arena, slabs are aligned to it so that a slot finds its slab by masking
+#define SLAB_SIZE 4096
+
+// Requests up to this size are served from the slabs, bigger ones go to the arena
+#define SLAB_MAX_SIZE 64
+
+// Smallest slot, slot sizes are multiples of it and of the arena alignment
+#define SLAB_MIN_SLOT 8
+
+// Number of size classes, one every SLAB_MIN_SLOT bytes up to SLAB_MAX_SIZE
+#define SLAB_CLASSES (SLAB_MAX_SIZE / SLAB_MIN_SLOT)
+
+// Number of words of the occupancy bitmap of a slab, enough for the smallest slots
+#define SLAB_MAP_WORDS (SLAB_SIZE / SLAB_MIN_SLOT / 64)
+
+/**
+ * @brief Header of a slab, stored in its last bytes so that the first slot keeps the alignment of the slab
+ *
+ * @param free bitmap of the free slots, a set bit is a free slot
+ * @param prev previous slab of the same class with free slots
+ * @param next next slab of the same class with free slots
+ * @param slot_size size of each slot
+ * @param slots number of slots of the slab
+ * @param used number of slots in use
+ */
+typedef struct Slab {
+    uint64_t free[SLAB_MAP_WORDS];
+    struct Slab *prev;
+    struct Slab *next;
+    uint32_t slot_size;
+    uint32_t slots;
+    uint32_t used;
+} Slab;
+
+/**
+ * @brief Arena serving its small requests from page-sized slabs of fixed-size slots
+ *
+ * Slots carry no header and are found with a ctz over the bitmap of their slab, so that frees of any size are
+ * reused, even those too small to hold a free block of the arena. Requests bigger than SLAB_MAX_SIZE are forwarded to
+ * the arena. Full slabs are dropped from the lists, empty ones are kept aside for any class unless they are the last
+ * slab of their class with free slots, slab_arena_trim gives them back to the arena. The slab arena is not thread safe
+ * and must not be used inside scopes of temporary allocations of its arena.
+ *
+ * @param arena arena the slabs and the big requests are carved from
+ * @param step size granularity of the slots, the arena alignment and at least SLAB_MIN_SLOT
+ * @param partial slabs with free slots of each size class
+ * @param empty stack of empty slabs, linked by their next pointer
+ * @param committed amount of memory committed in the slab arena, small and big requests alike
+ */
+typedef struct {
+    Arena *arena;
+    size_t step;
+    Slab *partial[SLAB_CLASSES];
+    Slab *empty;
+    size_t committed;
+} SlabArena;
+
+/**
+ * @brief Initialize an allocator with a slab arena
+ */
+#define slab_arena_alloc_init(s)                                                                                       \
+    (Allocator) {                                                                                                      \
+        slab_arena_alloc, slab_arena_free, slab_arena_realloc, slab_arena_calloc, slab_arena_allocated, s,             \
+            slab_arena_alloc_aligned                                                                                   \
+    }
+
+/**
+ * @brief Initialize a slab arena on top of an arena
+ *
+ * @param arena arena to carve the slabs from
+ * @return SlabArena
+ */
+SlabArena slab_arena_init(Arena *arena);
+/**
+ * @brief Allocate memory from a slab for small sizes, from the arena otherwise
+ *
+ * @param size size of the memory to allocate
+ * @param context slab arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *slab_arena_alloc(size_t size, void *context);
+/**
+ * @brief Reallocate memory, small memory moves unless it keeps the same slot size
+ *
+ * @param new_size new size of the memory to allocate
+ * @param old_size old size of the memory to reallocate
+ * @param ptr pointer to the memory to reallocate
+ * @param context slab arena to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory
+ */
+void *slab_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Allocate memory and set it to zero
+ *
+ * @param count number of elements to allocate
+ * @param size size of each element
+ * @param context slab arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *slab_arena_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Allocate memory aligned to the given boundary
+ *
+ * Small memory takes the first free slot at an aligned address, or the first slot of a new slab aligned to the
+ * boundary.
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2
+ * @param context slab arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *slab_arena_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Free memory to its slab for small sizes, to the arena otherwise
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context slab arena to free from, is a void* to statify the Allocator interface
+ */
+void slab_arena_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Allocate many blocks of the same size at once, small ones are taken a bitmap word at a time
+ *
+ * @param count number of blocks to allocate
+ * @param size size of each block
+ * @param out pointers to the allocated blocks, filled from the start
+ * @param context slab arena to allocate from, is a void* to statify the Allocator interface
+ * @return size_t number of blocks allocated, less than count if the arena is full
+ */
+size_t slab_arena_alloc_batch(size_t count, size_t size, void **out, void *context);
+/**
+ * @brief Free many blocks of the same size at once
+ *
+ * @param count number of blocks to free
+ * @param size size of each block
+ * @param ptrs pointers to the blocks to free, null pointers are skipped
+ * @param context slab arena to free from, is a void* to statify the Allocator interface
+ */
+void slab_arena_free_batch(size_t count, size_t size, void **ptrs, void *context);
+/**
+ * @brief Give the empty slabs kept aside back to the arena
+ *
+ * @param s slab arena to trim
+ * @return size_t number of slabs given back
+ */
+size_t slab_arena_trim(SlabArena *s);
+/**
+ * @brief Free all memory from the slab arena and from its arena
+ *
+ * @param context slab arena to free from, is a void* to statify the Allocator interface
+ */
+void slab_arena_free_all(void *context);
+/**
+ * @brief Get the total allocated memory from the slab arena
+ *
+ * @param context slab arena to get the allocated memory from, is a void* to statify the Allocator interface
+ * @return size_t total allocated memory
+ */
+static inline size_t slab_arena_allocated(void *context) { return ((SlabArena *)context)->committed; }
+
+#endif // _SLAB_H
@@ -0,0 +1,185 @@
+#include "stack_arena.h"
+#include "utils.h"
+
+#include <memory.h>
+
+/**
+ * @brief Size of the top of an end saved with each block, it may sit unaligned next to the block
+ */
+#define STACK_TOP_SIZE sizeof(size_t)
+
+/**
+ * @brief Push memory on one end
+ *
+ * @param side end to push on
+ * @param size size of the memory
+ * @param align alignment of the memory, at least the one of the stack arena
+ * @return void* pointer to the memory, null if the ends would meet
+ */
+static void *stack_side_push(StackSide *side, size_t size, size_t align);
+/**
+ * @brief Check whether a block is the last one pushed on its end
+ *
+ * @param side end the block belongs to
+ * @param ptr pointer to the block
+ * @param size size of the block
+ * @return int non-zero if the block can be popped
+ */
+static inline int stack_side_is_last(StackSide *side, void *ptr, size_t size);
+
+void stack_arena_init(StackArena *s, void *buffer, size_t size, size_t align) {
+    *s = (StackArena){
+        .base = (uint8_t *)buffer,
+        .size = size,
+        .align = align,
+        .low = 0,
+        .high = size,
+        .sides = {{.stack = s, .end = StackLow}, {.stack = s, .end = StackHigh}},
+    };
+}
+
+void *stack_arena_alloc(size_t size, void *context) {
+    StackSide *side = (StackSide *)context;
+    return stack_side_push(side, size, side->stack->align);
+}
+
+void *stack_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    StackSide *side = (StackSide *)context;
+    StackArena *s = side->stack;
+    if (!ptr) {
+        return stack_arena_alloc(new_size, context);
+    }
+    // like realloc, a size of zero frees the block and nothing is left to point to
+    if (!new_size) {
+        stack_arena_free(old_size, ptr, context);
+        return 0;
+    }
+
+    if (stack_side_is_last(side, ptr, old_size)) {
+        uintptr_t start = (uintptr_t)ptr;
+        if (side->end == StackLow) {
+            if (new_size <= (size_t)((uintptr_t)s->base + s->high - start)) {
+                s->low = (size_t)(start + new_size - (uintptr_t)s->base);
+                return ptr;
+            }
+        } else {
+            // the block keeps the top it was pushed on and moves its start, the data and the top slide down with it
+            size_t top;
+            memcpy(&top, (uint8_t *)ptr + old_size, sizeof(top));
+            uintptr_t end = (uintptr_t)s->base + top - STACK_TOP_SIZE;
+            uintptr_t new_start = (end - new_size) & ~(uintptr_t)(s->align - 1);
+            if (new_size <= end - (uintptr_t)s->base && new_start >= (uintptr_t)s->base + s->low) {
+                memmove((void *)new_start, ptr, new_size < old_size ? new_size : old_size);
+                memcpy((void *)(new_start + new_size), &top, sizeof(top));
+                s->high = (size_t)(new_start - (uintptr_t)s->base);
+                return (void *)new_start;
+            }
+        }
+    }
+
+    void *new_ptr = stack_arena_alloc(new_size, context);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, new_size < old_size ? new_size : old_size);
+        stack_arena_free(old_size, ptr, context);
+    }
+    return new_ptr;
+}
+
+void *stack_arena_calloc(size_t count, size_t size, void *context) {
+    size_t total_size = count * size;
+    void *ptr = stack_arena_alloc(total_size, context);
+    if (ptr) {
+        memset(ptr, 0, total_size);
+    }
+    return ptr;
+}
+
+void *stack_arena_alloc_aligned(size_t size, size_t align, void *context) {
+    StackSide *side = (StackSide *)context;
+    if (!is_power_of_two(align)) {
+        return 0;
+    }
+    return stack_side_push(side, size, align > side->stack->align ? align : side->stack->align);
+}
+
+void stack_arena_free(size_t size, void *ptr, void *context) {
+    StackSide *side = (StackSide *)context;
+    StackArena *s = side->stack;
+    if (!ptr || !stack_side_is_last(side, ptr, size)) {
+        return;
+    }
+
+    // the top of the end before the push is restored, the padding of an over-aligned block included
+    if (side->end == StackLow) {
+        memcpy(&s->low, (uint8_t *)ptr - STACK_TOP_SIZE, sizeof(s->low));
+    } else {
+        memcpy(&s->high, (uint8_t *)ptr + size, sizeof(s->high));
+    }
+}
+
+size_t stack_arena_mark(void *context) {
+    StackSide *side = (StackSide *)context;
+    return side->end == StackLow ? side->stack->low : side->stack->high;
+}
+
+void stack_arena_rewind(size_t mark, void *context) {
+    StackSide *side = (StackSide *)context;
+    StackArena *s = side->stack;
+    if (side->end == StackLow && mark < s->low) {
+        s->low = mark;
+    } else if (side->end == StackHigh && mark > s->high && mark <= s->size) {
+        s->high = mark;
+    }
+}
+
+void stack_arena_free_all(void *context) {
+    StackSide *side = (StackSide *)context;
+    stack_arena_rewind(side->end == StackLow ? 0 : side->stack->size, context);
+}
+
+size_t stack_arena_allocated(void *context) {
+    StackSide *side = (StackSide *)context;
+    return side->end == StackLow ? side->stack->low : side->stack->size - side->stack->high;
+}
+
+static void *stack_side_push(StackSide *side, size_t size, size_t align) {
+    StackArena *s = side->stack;
+    uintptr_t low = (uintptr_t)s->base + s->low;
+    uintptr_t high = (uintptr_t)s->base + s->high;
+
+    if (high - low < STACK_TOP_SIZE) {
+        return 0;
+    }
+
+    if (side->end == StackLow) {
+        // the top before the push is stored right below the block
+        uintptr_t start = (low + STACK_TOP_SIZE + align - 1) & ~(uintptr_t)(align - 1);
+        if (start > high || size > high - start) {
+            return 0;
+        }
+        memcpy((void *)(start - STACK_TOP_SIZE), &s->low, sizeof(s->low));
+        s->low = (size_t)(start + size - (uintptr_t)s->base);
+        return (void *)start;
+    }
+
+    // the top before the push is stored right above the block
+    if (size > high - low - STACK_TOP_SIZE) {
+        return 0;
+    }
+    uintptr_t start = (high - STACK_TOP_SIZE - size) & ~(uintptr_t)(align - 1);
+    if (start < low) {
+        return 0;
+    }
+    memcpy((void *)(start + size), &s->high, sizeof(s->high));
+    s->high = (size_t)(start - (uintptr_t)s->base);
+    return (void *)start;
+}
+
+static inline int stack_side_is_last(StackSide *side, void *ptr, size_t size) {
+    StackArena *s = side->stack;
+    if (side->end == StackLow) {
+        return (uintptr_t)ptr >= (uintptr_t)s->base + STACK_TOP_SIZE &&
+               (uintptr_t)ptr + size == (uintptr_t)s->base + s->low;
+    }
+    return (uintptr_t)ptr == (uintptr_t)s->base + s->high;
+}
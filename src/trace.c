@@ -0,0 +1,313 @@
+#define _DEFAULT_SOURCE
+
+#include "trace.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief Get the current time of the monotonic clock
+ *
+ * @return uint64_t time in nanoseconds
+ */
+static uint64_t trace_now(void);
+/**
+ * @brief Append a call to the trace file
+ *
+ * @param t recorder to write to
+ * @param op call to record
+ * @param id id of the allocation
+ * @param size size of the call
+ * @param arg second argument of the call
+ */
+static void trace_write(TraceRecorder *t, TraceOp op, uint64_t id, uint64_t size, uint64_t arg);
+/**
+ * @brief Give an id to a new pointer and record it in the table
+ *
+ * @param t recorder to update
+ * @param ptr new pointer
+ * @return uint64_t id of the pointer
+ */
+static uint64_t trace_table_add(TraceRecorder *t, void *ptr);
+/**
+ * @brief Insert a pointer in the table with a given id, growing the table when half full
+ *
+ * @param t recorder to update
+ * @param ptr pointer to insert
+ * @param id id of the pointer
+ */
+static void trace_table_put(TraceRecorder *t, void *ptr, uint64_t id);
+/**
+ * @brief Remove a pointer from the table
+ *
+ * @param t recorder to update
+ * @param ptr pointer to remove
+ * @param id id of the pointer, set only if it was found
+ * @return int non-zero if the pointer was found
+ */
+static int trace_table_take(TraceRecorder *t, void *ptr, uint64_t *id);
+/**
+ * @brief Get the home slot of a pointer in the table
+ *
+ * @param ptr pointer to hash
+ * @param capacity number of slots of the table, a power of 2
+ * @return size_t index of the slot
+ */
+static inline size_t trace_hash(void *ptr, size_t capacity);
+/**
+ * @brief Write an unsigned LEB128 varint
+ *
+ * @param file file to write to
+ * @param value value to write
+ */
+static void write_varint(FILE *file, uint64_t value);
+/**
+ * @brief Read an unsigned LEB128 varint
+ *
+ * @param file file to read from
+ * @param value value read
+ * @return int 1 if a value was read, 0 at the end of the file, -1 if the value is truncated
+ */
+static int read_varint(FILE *file, uint64_t *value);
+
+int trace_recorder_init(TraceRecorder *t, Allocator inner, const char *path) {
+    *t = (TraceRecorder){0};
+    t->inner = inner;
+    t->slots = calloc(TRACE_INITIAL_SLOTS, sizeof(TraceSlot));
+    if (!t->slots) {
+        return -1;
+    }
+    t->capacity = TRACE_INITIAL_SLOTS;
+
+    t->file = fopen(path, "wb");
+    if (!t->file) {
+        free(t->slots);
+        t->slots = 0;
+        return -1;
+    }
+
+    uint32_t magic = TRACE_MAGIC;
+    uint8_t header[5] = {magic & 0xff, (magic >> 8) & 0xff, (magic >> 16) & 0xff, magic >> 24, TRACE_VERSION};
+    fwrite(header, 1, sizeof(header), t->file);
+    t->last = trace_now();
+    return 0;
+}
+
+int trace_recorder_close(TraceRecorder *t) {
+    int result = 0;
+    if (t->file && fclose(t->file)) {
+        result = -1;
+    }
+    free(t->slots);
+    *t = (TraceRecorder){0};
+    return result;
+}
+
+void *trace_alloc(size_t size, void *context) {
+    TraceRecorder *t = (TraceRecorder *)context;
+    void *ptr = t->inner.alloc(size, t->inner.context);
+    if (ptr) {
+        trace_write(t, TraceAlloc, trace_table_add(t, ptr), size, 0);
+    }
+    return ptr;
+}
+
+void *trace_realloc(size_t new_size, size_t old_size, void *ptr, void *context) {
+    TraceRecorder *t = (TraceRecorder *)context;
+    // a size of zero frees the block, it is recorded as a free
+    if (ptr && !new_size) {
+        trace_free(old_size, ptr, context);
+        return 0;
+    }
+    void *new_ptr = t->inner.realloc(new_size, old_size, ptr, t->inner.context);
+    if (!new_ptr) {
+        return 0;
+    }
+
+    // memory allocated before the recording started shows up as a new allocation
+    uint64_t id;
+    if (ptr && trace_table_take(t, ptr, &id)) {
+        trace_table_put(t, new_ptr, id);
+        trace_write(t, TraceRealloc, id, new_size, old_size);
+    } else {
+        trace_write(t, TraceAlloc, trace_table_add(t, new_ptr), new_size, 0);
+    }
+    return new_ptr;
+}
+
+void *trace_calloc(size_t count, size_t size, void *context) {
+    TraceRecorder *t = (TraceRecorder *)context;
+    void *ptr = t->inner.calloc(count, size, t->inner.context);
+    if (ptr) {
+        trace_write(t, TraceCalloc, trace_table_add(t, ptr), size, count);
+    }
+    return ptr;
+}
+
+void *trace_alloc_aligned(size_t size, size_t align, void *context) {
+    TraceRecorder *t = (TraceRecorder *)context;
+    void *ptr = t->inner.alloc_aligned(size, align, t->inner.context);
+    if (ptr) {
+        trace_write(t, TraceAllocAligned, trace_table_add(t, ptr), size, align);
+    }
+    return ptr;
+}
+
+void trace_free(size_t size, void *ptr, void *context) {
+    TraceRecorder *t = (TraceRecorder *)context;
+    uint64_t id;
+    if (ptr && trace_table_take(t, ptr, &id)) {
+        trace_write(t, TraceFree, id, size, 0);
+    }
+    t->inner.free(size, ptr, t->inner.context);
+}
+
+int trace_reader_open(TraceReader *r, const char *path) {
+    *r = (TraceReader){0};
+    r->file = fopen(path, "rb");
+    if (!r->file) {
+        return -1;
+    }
+
+    uint8_t header[5];
+    if (fread(header, 1, sizeof(header), r->file) != sizeof(header) ||
+        (header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24) != TRACE_MAGIC ||
+        header[4] != TRACE_VERSION) {
+        fclose(r->file);
+        r->file = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int trace_reader_next(TraceReader *r, TraceEvent *event) {
+    int op = fgetc(r->file);
+    if (op == EOF) {
+        return 0;
+    }
+    if (op > TraceAllocAligned) {
+        return -1;
+    }
+
+    uint64_t delta;
+    if (read_varint(r->file, &delta) != 1 || read_varint(r->file, &event->id) != 1 ||
+        read_varint(r->file, &event->size) != 1 || read_varint(r->file, &event->arg) != 1) {
+        return -1;
+    }
+
+    r->time += delta;
+    event->op = (TraceOp)op;
+    event->time = r->time;
+    return 1;
+}
+
+void trace_reader_close(TraceReader *r) {
+    if (r->file) {
+        fclose(r->file);
+    }
+    *r = (TraceReader){0};
+}
+
+static uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void trace_write(TraceRecorder *t, TraceOp op, uint64_t id, uint64_t size, uint64_t arg) {
+    uint64_t now = trace_now();
+    fputc((int)op, t->file);
+    write_varint(t->file, now - t->last);
+    write_varint(t->file, id);
+    write_varint(t->file, size);
+    write_varint(t->file, arg);
+    t->last = now;
+}
+
+static uint64_t trace_table_add(TraceRecorder *t, void *ptr) {
+    uint64_t id = t->next_id++;
+    trace_table_put(t, ptr, id);
+    return id;
+}
+
+static void trace_table_put(TraceRecorder *t, void *ptr, uint64_t id) {
+    if (2 * (t->count + 1) > t->capacity) {
+        TraceSlot *slots = calloc(2 * t->capacity, sizeof(TraceSlot));
+        // without a bigger table the pointer is left out, its free is forwarded but not recorded
+        if (!slots) {
+            return;
+        }
+
+        TraceSlot *old = t->slots;
+        size_t capacity = t->capacity;
+        t->slots = slots;
+        t->capacity = 2 * capacity;
+        t->count = 0;
+        for (size_t i = 0; i < capacity; i++) {
+            if (old[i].ptr) {
+                trace_table_put(t, old[i].ptr, old[i].id);
+            }
+        }
+        free(old);
+    }
+
+    size_t i = trace_hash(ptr, t->capacity);
+    while (t->slots[i].ptr) {
+        i = (i + 1) & (t->capacity - 1);
+    }
+    t->slots[i] = (TraceSlot){ptr, id};
+    t->count++;
+}
+
+static int trace_table_take(TraceRecorder *t, void *ptr, uint64_t *id) {
+    size_t mask = t->capacity - 1;
+    size_t i = trace_hash(ptr, t->capacity);
+    while (t->slots[i].ptr != ptr) {
+        if (!t->slots[i].ptr) {
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+    *id = t->slots[i].id;
+    t->count--;
+
+    // shift the following slots back so that no probe sequence is broken by the hole
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; t->slots[j].ptr; j = (j + 1) & mask) {
+        size_t home = trace_hash(t->slots[j].ptr, t->capacity);
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            t->slots[hole] = t->slots[j];
+            hole = j;
+        }
+    }
+    t->slots[hole] = (TraceSlot){0};
+    return 1;
+}
+
+static inline size_t trace_hash(void *ptr, size_t capacity) {
+    uint64_t h = (uint64_t)(uintptr_t)ptr * 0x9e3779b97f4a7c15u;
+    return (size_t)(h >> 32) & (capacity - 1);
+}
+
+static void write_varint(FILE *file, uint64_t value) {
+    while (value >= 0x80) {
+        fputc((int)(value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    fputc((int)value, file);
+}
+
+static int read_varint(FILE *file, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(file);
+        if (byte == EOF) {
+            return shift ? -1 : 0;
+        }
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return 1;
+        }
+    }
+    return -1;
+}
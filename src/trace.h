@@ -0,0 +1,202 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "alloc.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Magic number at the start of every trace file, "ATRC" in little endian
+#define TRACE_MAGIC 0x43525441u
+
+// Version of the trace format
+#define TRACE_VERSION 1
+
+// Initial number of slots of the table mapping live pointers to their ids
+#define TRACE_INITIAL_SLOTS 1024
+
+/**
+ * @brief Calls recorded in a trace
+ *
+ * TraceAlloc: size is the requested size
+ *
+ * TraceFree: size is the size given to free
+ *
+ * TraceRealloc: size is the new size, arg is the old size
+ *
+ * TraceCalloc: size is the size of an element, arg is the number of elements
+ *
+ * TraceAllocAligned: size is the requested size, arg is the alignment
+ */
+typedef enum {
+    TraceAlloc = 0,
+    TraceFree = 1,
+    TraceRealloc = 2,
+    TraceCalloc = 3,
+    TraceAllocAligned = 4,
+} TraceOp;
+
+/**
+ * @brief Single call read back from a trace
+ *
+ * @param op call recorded
+ * @param time nanoseconds elapsed since the recording started
+ * @param id id of the allocation, given in order from 0 when the memory is first allocated
+ * @param size size of the call, see TraceOp
+ * @param arg second argument of the call, see TraceOp
+ */
+typedef struct {
+    TraceOp op;
+    uint64_t time;
+    uint64_t id;
+    uint64_t size;
+    uint64_t arg;
+} TraceEvent;
+
+/**
+ * @brief Slot of the table mapping live pointers to their ids
+ *
+ * @param ptr live pointer, null for an empty slot
+ * @param id id of the allocation
+ */
+typedef struct {
+    void *ptr;
+    uint64_t id;
+} TraceSlot;
+
+/**
+ * @brief Recording wrapper forwarding every call to another allocator
+ *
+ * Every successful call is appended to the trace file, a byte for the call then the time delta since the previous
+ * call, the id, the size and the argument encoded as LEB128 varints. The recorder is not thread safe.
+ *
+ * @param inner allocator the calls are forwarded to
+ * @param file trace file
+ * @param last time of the previous call
+ * @param next_id id of the next allocation
+ * @param slots open addressing table of the live pointers, its memory comes from malloc and not from inner
+ * @param capacity number of slots, a power of 2
+ * @param count number of live pointers in the table
+ */
+typedef struct {
+    Allocator inner;
+    FILE *file;
+    uint64_t last;
+    uint64_t next_id;
+    TraceSlot *slots;
+    size_t capacity;
+    size_t count;
+} TraceRecorder;
+
+/**
+ * @brief Reader of a trace file
+ *
+ * @param file trace file
+ * @param time time of the last event read
+ */
+typedef struct {
+    FILE *file;
+    uint64_t time;
+} TraceReader;
+
+/**
+ * @brief Initialize an allocator with a trace recorder
+ */
+#define trace_alloc_init(t)                                                                                            \
+    (Allocator) { trace_alloc, trace_free, trace_realloc, trace_calloc, trace_allocated, t, trace_alloc_aligned }
+
+/**
+ * @brief Start recording the calls made to an allocator
+ *
+ * @param t recorder to initialize
+ * @param inner allocator the calls are forwarded to
+ * @param path path of the trace file, truncated if it exists
+ * @return int 0 on success, -1 if the file cannot be written or the table cannot be allocated
+ */
+int trace_recorder_init(TraceRecorder *t, Allocator inner, const char *path);
+/**
+ * @brief Stop recording, flush and close the trace file
+ *
+ * The live allocations stay valid in the inner allocator.
+ *
+ * @param t recorder to close
+ * @return int 0 on success, -1 if the trace could not be flushed
+ */
+int trace_recorder_close(TraceRecorder *t);
+/**
+ * @brief Allocate memory from the inner allocator and record the call
+ *
+ * @param size size of the memory to allocate
+ * @param context recorder to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *trace_alloc(size_t size, void *context);
+/**
+ * @brief Reallocate memory from the inner allocator and record the call
+ *
+ * @param new_size new size of the memory, 0 frees the memory
+ * @param old_size old size of the memory
+ * @param ptr pointer to the memory to reallocate
+ * @param context recorder to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory, null once freed
+ */
+void *trace_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Allocate zeroed memory from the inner allocator and record the call
+ *
+ * @param count number of elements
+ * @param size size of each element
+ * @param context recorder to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *trace_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Allocate aligned memory from the inner allocator and record the call
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2
+ * @param context recorder to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *trace_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Free memory from the inner allocator and record the call
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context recorder to free from, is a void* to statify the Allocator interface
+ */
+void trace_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Get the total allocated memory from the inner allocator
+ *
+ * @param context recorder to get the allocated memory from, is a void* to statify the Allocator interface
+ * @return size_t total allocated memory
+ */
+static inline size_t trace_allocated(void *context) {
+    TraceRecorder *t = (TraceRecorder *)context;
+    return (t->inner.allocated)(t->inner.context);
+}
+/**
+ * @brief Open a trace file for reading
+ *
+ * @param r reader to initialize
+ * @param path path of the trace file
+ * @return int 0 on success, -1 if the file cannot be read or is not a trace
+ */
+int trace_reader_open(TraceReader *r, const char *path);
+/**
+ * @brief Read the next event of a trace
+ *
+ * @param r reader to read from
+ * @param event event to fill
+ * @return int 1 if an event was read, 0 at the end of the trace, -1 if the trace is truncated or corrupted
+ */
+int trace_reader_next(TraceReader *r, TraceEvent *event);
+/**
+ * @brief Close a trace file
+ *
+ * @param r reader to close
+ */
+void trace_reader_close(TraceReader *r);
+
+#endif // _TRACE_H
@@ -0,0 +1,149 @@
+#ifndef _FRAME_ARENA_H
+#define _FRAME_ARENA_H
+
+#include "arena.h"
+
+// Maximum number of arenas a frame arena rotates among
+#define FRAME_ARENA_MAX_FRAMES 8
+
+// Maximum number of readers registered at the same time, each one uses its own index
+#define FRAME_ARENA_MAX_READERS 64
+
+// Size of a cache line, the slot of each reader and the epoch are kept on their own
+#define FRAME_ARENA_CACHE_LINE 64
+
+/**
+ * @brief Slot of a reader, alone on its cache line so that entering and leaving do not slow down the other readers
+ *
+ * @param epoch epoch entered by the reader plus one, 0 outside of any epoch
+ */
+typedef struct {
+    _Alignas(FRAME_ARENA_CACHE_LINE) size_t epoch;
+} FrameReader;
+
+/**
+ * @brief Arenas rotated at each tick of a stream, reclaimed once no reader can see their data anymore
+ *
+ * A single producer allocates the data of tick n from arena n % count while the epoch is n, and advances the epoch
+ * once the tick is complete. Readers enter an epoch e to read the completed tick e - 1. Advancing to epoch n + 1 resets
+ * the arena of tick n + 1 - count, after waiting for the readers that entered an epoch up to the one following it. With
+ * two arenas, the data of tick n stays alive until the readers of epoch n + 1 leave, more arenas let the producer run
+ * ahead of slow readers. Objects are never freed one by one, the frame arena must not be moved or copied once
+ * initialized. It is aligned to FRAME_ARENA_CACHE_LINE, aligned_alloc keeps that alignment on the heap.
+ *
+ * @param frames arenas holding the data of the last count ticks, only used by the producer
+ * @param count number of arenas to rotate among
+ * @param epoch current epoch, the tick being produced, away from the arenas the producer updates on each allocation
+ * @param readers slot of each reader
+ */
+typedef struct {
+    Arena frames[FRAME_ARENA_MAX_FRAMES];
+    size_t count;
+    _Alignas(FRAME_ARENA_CACHE_LINE) size_t epoch;
+    FrameReader readers[FRAME_ARENA_MAX_READERS];
+} FrameArena;
+
+/**
+ * @brief Initialize an allocator with a frame arena, the producer allocates from the arena of the current tick
+ */
+#define frame_arena_alloc_init(f)                                                                                      \
+    (Allocator) {                                                                                                      \
+        frame_arena_alloc, frame_arena_free, frame_arena_realloc, frame_arena_calloc, frame_arena_allocated, f,        \
+            frame_arena_alloc_aligned                                                                                  \
+    }
+
+/**
+ * @brief Initialize a frame arena on top of arenas, the frame arena takes ownership of them
+ *
+ * @param f frame arena to initialize
+ * @param frames arenas to rotate among
+ * @param count number of arenas, at least 2 and at most FRAME_ARENA_MAX_FRAMES
+ * @return int 0 on success, an error number otherwise
+ */
+int frame_arena_init(FrameArena *f, const Arena *frames, size_t count);
+/**
+ * @brief Destroy a frame arena, no reader may be inside an epoch anymore
+ *
+ * The arenas are destroyed too, see arena_destroy.
+ *
+ * @param f frame arena to destroy
+ */
+void frame_arena_destroy(FrameArena *f);
+/**
+ * @brief Complete the current tick and start the next one, only from the producer
+ *
+ * The arena of the next tick is reset once the readers that may still read its old data left their epoch, the
+ * producer waits for them.
+ *
+ * @param f frame arena to advance
+ * @return size_t the new epoch
+ */
+size_t frame_arena_advance(FrameArena *f);
+/**
+ * @brief Enter the current epoch as a reader, the data of the tick before it stays alive until the reader leaves
+ *
+ * @param f frame arena to read
+ * @param reader index of the reader, below FRAME_ARENA_MAX_READERS and used by a single thread at a time
+ * @return size_t epoch entered, tick epoch - 1 is the one to read, none before the first advance
+ */
+size_t frame_arena_enter(FrameArena *f, size_t reader);
+/**
+ * @brief Leave the epoch entered by a reader
+ *
+ * @param f frame arena being read
+ * @param reader index of the reader
+ */
+void frame_arena_leave(FrameArena *f, size_t reader);
+/**
+ * @brief Allocate memory for the current tick
+ *
+ * @param size size of the memory to allocate
+ * @param context frame arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *frame_arena_alloc(size_t size, void *context);
+/**
+ * @brief Reallocate memory, memory of a previous tick is copied to the current one
+ *
+ * @param new_size new size of the memory to allocate
+ * @param old_size old size of the memory to reallocate
+ * @param ptr pointer to the memory to reallocate
+ * @param context frame arena to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory
+ */
+void *frame_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Allocate memory for the current tick and set it to zero
+ *
+ * @param count number of elements to allocate
+ * @param size size of each element
+ * @param context frame arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *frame_arena_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Allocate memory for the current tick aligned to the given boundary
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2
+ * @param context frame arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *frame_arena_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Free memory of the current tick, memory of previous ticks is only reclaimed with their arena
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context frame arena to free from, is a void* to statify the Allocator interface
+ */
+void frame_arena_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Get the total allocated memory from the arenas of the ticks still kept
+ *
+ * @param context frame arena to get the allocated memory from, is a void* to statify the Allocator interface
+ * @return size_t total allocated memory
+ */
+size_t frame_arena_allocated(void *context);
+
+#endif // _FRAME_ARENA_H
@@ -0,0 +1,141 @@
+#ifndef _NUMA_ARENA_H
+#define _NUMA_ARENA_H
+
+#include "concurrent_arena.h"
+
+// Maximum number of NUMA nodes served by a NUMA arena
+#define NUMA_MAX_NODES 64
+
+// Maximum number of CPUs mapped to their node, threads on other CPUs use the first node
+#define NUMA_MAX_CPUS 1024
+
+/**
+ * @brief Set of arenas, one for each NUMA node, threads allocate from the arena of the node they run on
+ *
+ * Machines without NUMA, or systems other than Linux, get a single node and behave like a concurrent arena. When the
+ * memory of an arena cannot be bound to its node, the set collapses to a single unbound arena serving every thread.
+ *
+ * @param nodes number of nodes, 1 once collapsed
+ * @param node_ids system id of each node
+ * @param arenas concurrent arena of each node, the memory of each is bound to its node when bound is set
+ * @param bound non-zero if the memory policy of the arenas could be set, zero once collapsed to a single arena
+ * @param cpu_node index of the node of each CPU
+ */
+typedef struct {
+    size_t nodes;
+    int node_ids[NUMA_MAX_NODES];
+    ConcurrentArena *arenas;
+    int bound;
+    uint8_t cpu_node[NUMA_MAX_CPUS];
+} NumaArena;
+
+/**
+ * @brief Initialize an allocator with a NUMA arena
+ */
+#define numa_arena_alloc_init(n)                                                                                       \
+    (Allocator) {                                                                                                      \
+        numa_arena_alloc, numa_arena_free, numa_arena_realloc, numa_arena_calloc, numa_arena_allocated, n,             \
+            numa_arena_alloc_aligned                                                                                   \
+    }
+
+/**
+ * @brief Initialize a NUMA arena, reserving a virtual arena on each node
+ *
+ * The NUMA arena must not be moved or copied once initialized.
+ *
+ * @param n NUMA arena to initialize
+ * @param reserve size of the address range reserved for each node
+ * @param commit_chunk amount of memory committed at once, 0 for DEFAULT_COMMIT_CHUNK
+ * @param align alignment of the arenas, must be a power of 2, use DEFAULT_ALLIGNMENT for default
+ * @param strategy strategy for reusing blocks
+ * @return int 0 on success, an error number otherwise
+ */
+int numa_arena_init(NumaArena *n, size_t reserve, size_t commit_chunk, size_t align, AllocationStrategy strategy);
+/**
+ * @brief Initialize a NUMA arena on the given nodes only, reserving a virtual arena on each node
+ *
+ * The NUMA arena must not be moved or copied once initialized.
+ *
+ * @param n NUMA arena to initialize
+ * @param node_ids system id of each node
+ * @param nodes number of nodes, at most NUMA_MAX_NODES
+ * @param reserve size of the address range reserved for each node
+ * @param commit_chunk amount of memory committed at once, 0 for DEFAULT_COMMIT_CHUNK
+ * @param align alignment of the arenas, must be a power of 2, use DEFAULT_ALLIGNMENT for default
+ * @param strategy strategy for reusing blocks
+ * @return int 0 on success, an error number otherwise
+ */
+int numa_arena_init_nodes(NumaArena *n, const int *node_ids, size_t nodes, size_t reserve, size_t commit_chunk,
+                          size_t align, AllocationStrategy strategy);
+/**
+ * @brief Release the arenas of every node
+ *
+ * @param n NUMA arena to destroy
+ */
+void numa_arena_destroy(NumaArena *n);
+/**
+ * @brief Get the node the calling thread runs on
+ *
+ * @param n NUMA arena to look the node up in
+ * @return size_t index of the node in the NUMA arena
+ */
+size_t numa_arena_current_node(NumaArena *n);
+/**
+ * @brief Allocate memory from the arena of the node the calling thread runs on
+ *
+ * @param size size of the memory to allocate
+ * @param context NUMA arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *numa_arena_alloc(size_t size, void *context);
+/**
+ * @brief Reallocate memory in the arena it was allocated from, the memory stays on its node
+ *
+ * @param new_size new size of the memory
+ * @param old_size old size of the memory
+ * @param ptr pointer to the memory to reallocate, null to allocate on the current node
+ * @param context NUMA arena to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory
+ */
+void *numa_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Allocate zeroed memory from the arena of the node the calling thread runs on
+ *
+ * @param count number of elements
+ * @param size size of each element
+ * @param context NUMA arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *numa_arena_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Allocate aligned memory from the arena of the node the calling thread runs on
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2
+ * @param context NUMA arena to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *numa_arena_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Free memory to the arena it was allocated from, from any thread and any node
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context NUMA arena to free from, is a void* to statify the Allocator interface
+ */
+void numa_arena_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Give the blocks cached by the calling thread back to the arenas of every node
+ *
+ * @param context NUMA arena to flush, is a void* to statify the Allocator interface
+ */
+void numa_arena_flush(void *context);
+/**
+ * @brief Get the total allocated memory from the arenas of every node
+ *
+ * @param context NUMA arena to get the allocated memory from, is a void* to statify the Allocator interface
+ * @return size_t total allocated memory
+ */
+size_t numa_arena_allocated(void *context);
+
+#endif // _NUMA_ARENA_H
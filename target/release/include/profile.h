@@ -0,0 +1,194 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "alloc.h"
+#include "arena.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Default mean number of bytes allocated between two samples
+#define PROFILE_DEFAULT_RATE (512 * 1024)
+
+// Maximum number of frames captured for a sample
+#define PROFILE_MAX_DEPTH 32
+
+// Initial number of slots of the tables of stacks and of live samples
+#define PROFILE_INITIAL_SLOTS 256
+
+/**
+ * @brief Call stack of sampled allocations with their statistics
+ *
+ * @param hash hash of the frames
+ * @param depth number of frames
+ * @param frames return addresses, innermost first
+ * @param inuse_objects sampled allocations of the stack still live
+ * @param inuse_bytes bytes of the sampled allocations still live
+ * @param alloc_objects sampled allocations of the stack since the start
+ * @param alloc_bytes bytes of the sampled allocations since the start
+ */
+typedef struct {
+    uint64_t hash;
+    size_t depth;
+    void *frames[PROFILE_MAX_DEPTH];
+    uint64_t inuse_objects;
+    uint64_t inuse_bytes;
+    uint64_t alloc_objects;
+    uint64_t alloc_bytes;
+} ProfileStack;
+
+/**
+ * @brief Slot of the table mapping live sampled pointers to their stacks
+ *
+ * @param ptr live sampled pointer, null for an empty slot
+ * @param stack stack the pointer was allocated from
+ * @param size size of the allocation
+ */
+typedef struct {
+    void *ptr;
+    ProfileStack *stack;
+    size_t size;
+} ProfileSlot;
+
+/**
+ * @brief Sampling heap profiler forwarding every call to another allocator
+ *
+ * An allocation is sampled each time about rate bytes were allocated, the intervals are drawn from an exponential
+ * distribution so that the profile can be scaled back to the whole heap. Only sampled allocations capture their call
+ * stack, other allocations cost a subtraction and a branch. While samples are live, each free probes their table,
+ * usually a single slot. The profiler is not thread safe.
+ *
+ * A profiler started with profiler_init_arena counts down from the allocation path of the arena instead, unsampled
+ * calls then go straight to the arena without a second call through the Allocator interface.
+ *
+ * @param sampler countdown to the next sample and number of live sampled pointers, first so that the hooks of the
+ * arena find the profiler
+ * @param inner allocator the calls are forwarded to
+ * @param arena arena sampled from its own allocation path, null if none
+ * @param rate mean number of bytes between two samples
+ * @param seed state of the generator of the sampling intervals
+ * @param stacks open addressing table of the stacks, their memory comes from malloc and not from inner
+ * @param stack_capacity number of slots of the table of stacks, a power of 2
+ * @param stack_count number of stacks
+ * @param live open addressing table of the live sampled pointers, its memory comes from malloc and not from inner
+ * @param live_capacity number of slots of the table of live pointers, a power of 2
+ */
+typedef struct {
+    ArenaSampler sampler;
+    Allocator inner;
+    Arena *arena;
+    size_t rate;
+    uint64_t seed;
+    ProfileStack **stacks;
+    size_t stack_capacity;
+    size_t stack_count;
+    ProfileSlot *live;
+    size_t live_capacity;
+} HeapProfiler;
+
+/**
+ * @brief Initialize an allocator with a heap profiler
+ */
+#define profiler_alloc_init(p)                                                                                         \
+    (Allocator) {                                                                                                      \
+        profiler_alloc, profiler_free, profiler_realloc, profiler_calloc, profiler_allocated, p,                       \
+            profiler_alloc_aligned                                                                                     \
+    }
+
+/**
+ * @brief Start profiling the calls made to an allocator
+ *
+ * @param p profiler to initialize
+ * @param inner allocator the calls are forwarded to
+ * @param rate mean number of bytes between two samples, 1 samples every allocation, 0 for PROFILE_DEFAULT_RATE
+ * @return int 0 on success, -1 if the tables cannot be allocated
+ */
+int profiler_init(HeapProfiler *p, Allocator inner, size_t rate);
+/**
+ * @brief Start profiling an arena from its own allocation path
+ *
+ * The arena is used through arena_alloc_init and not through profiler_alloc_init, which would sample every call twice.
+ * The allocators built on top of the arena are profiled as well.
+ *
+ * @param p profiler to initialize
+ * @param a arena to profile, it keeps a pointer to the profiler until profiler_destroy
+ * @param rate mean number of bytes between two samples, 1 samples every allocation, 0 for PROFILE_DEFAULT_RATE
+ * @return int 0 on success, -1 if the tables cannot be allocated
+ */
+int profiler_init_arena(HeapProfiler *p, Arena *a, size_t rate);
+/**
+ * @brief Stop profiling and free the tables
+ *
+ * The live allocations stay valid in the inner allocator, a profiled arena stops sampling.
+ *
+ * @param p profiler to destroy
+ */
+void profiler_destroy(HeapProfiler *p);
+/**
+ * @brief Allocate memory from the inner allocator, sampling the call
+ *
+ * @param size size of the memory to allocate
+ * @param context profiler to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *profiler_alloc(size_t size, void *context);
+/**
+ * @brief Reallocate memory from the inner allocator, a sampled block keeps its sample
+ *
+ * The bytes a block grows by count towards the next sample, a block sampled this way is recorded with its new size.
+ *
+ * @param new_size new size of the memory, 0 frees the memory
+ * @param old_size old size of the memory
+ * @param ptr pointer to the memory to reallocate
+ * @param context profiler to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory, null once freed
+ */
+void *profiler_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Allocate zeroed memory from the inner allocator, sampling the call
+ *
+ * @param count number of elements
+ * @param size size of each element
+ * @param context profiler to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *profiler_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Allocate aligned memory from the inner allocator, sampling the call
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2
+ * @param context profiler to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *profiler_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Free memory from the inner allocator, a sampled allocation leaves the in-use profile
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context profiler to free from, is a void* to statify the Allocator interface
+ */
+void profiler_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Write the in-use and allocated profiles in the legacy heap profile format read by pprof
+ *
+ * Sampled counts are written as they are, the heap_v2 header gives the rate so that pprof scales them back. The
+ * mappings of the process follow the stacks so that the addresses can be symbolized.
+ *
+ * @param p profiler to dump
+ * @param path path of the profile, truncated if it exists
+ * @return int 0 on success, -1 if the file cannot be written
+ */
+int profiler_write(HeapProfiler *p, const char *path);
+/**
+ * @brief Get the total allocated memory from the inner allocator
+ *
+ * @param context profiler to get the allocated memory from, is a void* to statify the Allocator interface
+ * @return size_t total allocated memory
+ */
+static inline size_t profiler_allocated(void *context) {
+    HeapProfiler *p = (HeapProfiler *)context;
+    return (p->inner.allocated)(p->inner.context);
+}
+
+#endif // _PROFILE_H
@@ -0,0 +1,143 @@
+#ifndef _STACK_ARENA_H
+#define _STACK_ARENA_H
+
+#include "arena.h"
+
+/**
+ * @brief End of a stack arena
+ *
+ * StackLow: Grows up from the start of the buffer
+ *
+ * StackHigh: Grows down from the end of the buffer
+ */
+typedef enum {
+    StackLow = 0,
+    StackHigh = 1,
+} StackEnd;
+
+/**
+ * @brief One end of a stack arena, the context of its allocator
+ *
+ * @param stack stack arena the end belongs to
+ * @param end which end of the buffer it grows from
+ */
+typedef struct StackSide {
+    struct StackArena *stack;
+    StackEnd end;
+} StackSide;
+
+/**
+ * @brief Buffer shared by two stacks growing towards each other, each with its own allocator
+ *
+ * Each block is pushed next to the top its end had before, freeing the last block of an end pops it back to that top,
+ * alignment padding included, freeing any other block leaves its memory in use until a mark below it is rewound.
+ * Long-lived results are allocated from one end and temporaries from the other, so that they never interleave. The
+ * stack arena must not be moved or copied once initialized.
+ *
+ * @param base start of the buffer
+ * @param size size of the buffer
+ * @param align alignment of the memory of both ends
+ * @param low offset of the top of the low end, where its next block starts
+ * @param high offset of the bottom of the high end, where its next block ends
+ * @param sides allocator contexts of the low and high ends
+ */
+typedef struct StackArena {
+    uint8_t *base;
+    size_t size;
+    size_t align;
+    size_t low;
+    size_t high;
+    StackSide sides[2];
+} StackArena;
+
+/**
+ * @brief Initialize an allocator with one end of a stack arena
+ */
+#define stack_arena_alloc_init(s, end)                                                                                 \
+    (Allocator) {                                                                                                      \
+        stack_arena_alloc, stack_arena_free, stack_arena_realloc, stack_arena_calloc, stack_arena_allocated,           \
+            &(s)->sides[end], stack_arena_alloc_aligned                                                                \
+    }
+
+/**
+ * @brief Initialize a stack arena on a buffer, both ends empty
+ *
+ * @param s stack arena to initialize
+ * @param buffer buffer to allocate from, owned by the caller
+ * @param size size of the buffer
+ * @param align alignment of the memory, must be a power of 2, use DEFAULT_ALLIGNMENT for default
+ */
+void stack_arena_init(StackArena *s, void *buffer, size_t size, size_t align);
+/**
+ * @brief Push memory on one end
+ *
+ * @param size size of the memory to allocate
+ * @param context end to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory, null if the ends would meet
+ */
+void *stack_arena_alloc(size_t size, void *context);
+/**
+ * @brief Reallocate memory, the last block of an end is resized in place
+ *
+ * @param new_size new size of the memory to allocate
+ * @param old_size old size of the memory to reallocate
+ * @param ptr pointer to the memory to reallocate
+ * @param context end to reallocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the reallocated memory
+ */
+void *stack_arena_realloc(size_t new_size, size_t old_size, void *ptr, void *context);
+/**
+ * @brief Push memory on one end and set it to zero
+ *
+ * @param count number of elements to allocate
+ * @param size size of each element
+ * @param context end to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *stack_arena_calloc(size_t count, size_t size, void *context);
+/**
+ * @brief Push memory on one end aligned to the given boundary
+ *
+ * @param size size of the memory to allocate
+ * @param align alignment of the memory, must be a power of 2
+ * @param context end to allocate from, is a void* to statify the Allocator interface
+ * @return void* pointer to the allocated memory
+ */
+void *stack_arena_alloc_aligned(size_t size, size_t align, void *context);
+/**
+ * @brief Pop memory if it is the last block of its end, other blocks stay until a mark below them is rewound
+ *
+ * @param size size of the memory to free
+ * @param ptr pointer to the memory to free
+ * @param context end to free from, is a void* to statify the Allocator interface
+ */
+void stack_arena_free(size_t size, void *ptr, void *context);
+/**
+ * @brief Get the current position of one end
+ *
+ * @param context end to mark, is a void* to statify the Allocator interface
+ * @return size_t mark to rewind to
+ */
+size_t stack_arena_mark(void *context);
+/**
+ * @brief Pop every block pushed on one end since the mark
+ *
+ * @param mark position of the end returned by stack_arena_mark
+ * @param context end to rewind, is a void* to statify the Allocator interface
+ */
+void stack_arena_rewind(size_t mark, void *context);
+/**
+ * @brief Pop every block of one end, the other end is untouched
+ *
+ * @param context end to empty, is a void* to statify the Allocator interface
+ */
+void stack_arena_free_all(void *context);
+/**
+ * @brief Get the memory used by one end, blocks not popped yet, their saved tops and alignment padding included
+ *
+ * @param context end to get the used memory from, is a void* to statify the Allocator interface
+ * @return size_t memory used by the end
+ */
+size_t stack_arena_allocated(void *context);
+
+#endif // _STACK_ARENA_H
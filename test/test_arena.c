@@ -80,6 +80,264 @@ int main(void) {
 
     arena_free_all(&arena);
 
+    // LIFO frees move the offset back down
+    char *first = make(char, 100, allocator);
+    char *second = make(char, 200, allocator);
+    release(char, 200, second, allocator);
+    release(char, 100, first, allocator);
+
+    assert(arena.offset == 0, "Offset not rewound, offset: %zu\n", arena.offset);
+
+    // a full arena merges its free neighbours before giving up
+    Arena small_arena = arena_init(buffer, 1024, DEFAULT_ALLIGNMENT, FirstFit);
+    Allocator small_allocator = arena_alloc_init(&small_arena);
+
+    char *blocks[4];
+    for (int i = 0; i < 4; i += 1)
+        blocks[i] = make(char, 256, small_allocator);
+
+    release(char, 256, blocks[0], small_allocator);
+    release(char, 256, blocks[1], small_allocator);
+
+    char *merged = make(char, 512, small_allocator);
+    assert(merged == blocks[0], "Free blocks not coalesced\n");
+
+    release(char, 512, merged, small_allocator);
+    release(char, 256, blocks[3], small_allocator);
+    release(char, 256, blocks[2], small_allocator);
+    arena_coalesce(&small_arena);
+
+    assert(small_arena.offset == 0, "Offset not rewound after coalescing, offset: %zu\n", small_arena.offset);
+    assert(allocated(small_allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(small_allocator));
+
+    // an arena with room left merges its free neighbours too once enough blocks were freed
+    arena_free_all(&arena);
+
+    char *fragments[FREE_LIST_COALESCE_MIN];
+    for (int i = 0; i < FREE_LIST_COALESCE_MIN; i += 1)
+        fragments[i] = make(char, 64, allocator);
+    char *guard = make(char, 64, allocator);
+    for (int i = 0; i < FREE_LIST_COALESCE_MIN; i += 1)
+        release(char, 64, fragments[i], allocator);
+
+    size_t top = arena.offset;
+    char *joined = make(char, 64 * FREE_LIST_COALESCE_MIN, allocator);
+    assert(joined == fragments[0], "Fragments not coalesced\n");
+    assert(arena.offset == top, "Offset grew over free fragments, offset: %zu\n", arena.offset);
+
+    release(char, 64 * FREE_LIST_COALESCE_MIN, joined, allocator);
+    release(char, 64, guard, allocator);
+
+    // scopes of temporary allocations drop everything at once, nested scopes included
+    arena_free_all(&arena);
+
+    char *persistent = make(char, 64, allocator);
+    char *freed_in_scope = make(char, 64, allocator);
+    size_t mark = arena.offset;
+
+    ArenaTemp outer;
+    arena_temp_begin(&outer, &arena);
+
+    for (int i = 0; i < 10; i += 1)
+        make(int, 100, allocator);
+    release(char, 64, freed_in_scope, allocator);
+
+    ArenaTemp inner;
+    arena_temp_begin(&inner, &arena);
+    for (int i = 0; i < 10; i += 1)
+        make(size_t, 100, allocator);
+    arena_temp_end(&inner);
+
+    arena_temp_end(&outer);
+
+    assert(arena.offset == mark, "Scope not rewound, offset: %zu\n", arena.offset);
+    assert(allocated(allocator) == 64, "Expected 64 allocated, allocated: %zu\n", allocated(allocator));
+
+    char *reused = make(char, 64, allocator);
+    assert(reused == freed_in_scope, "Block freed inside the scope not reusable\n");
+
+    release(char, 64, reused, allocator);
+    release(char, 64, persistent, allocator);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // realloc grows in place on top of the arena and into a following free block, shrinking gives the tail back
+    arena_free_all(&arena);
+
+    char *growing = make(char, 32, allocator);
+    char *grown = resize(char, 64, 32, growing, allocator);
+    assert(grown == growing, "Top block not grown in place\n");
+
+    char *follower = make(char, 64, allocator);
+    char *last = make(char, 16, allocator);
+    release(char, 64, follower, allocator);
+
+    grown = resize(char, 128, 64, growing, allocator);
+    assert(grown == growing, "Block not grown into the following free block\n");
+
+    grown = resize(char, 32, 128, growing, allocator);
+    char *from_tail = make(char, 96, allocator);
+    assert(from_tail == growing + 32, "Shrunk tail not reused\n");
+
+    release(char, 96, from_tail, allocator);
+    release(char, 16, last, allocator);
+    release(char, 32, grown, allocator);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // a size of zero frees the block, like realloc
+    growing = make(char, 48, allocator);
+    grown = resize(char, 0, 48, growing, allocator);
+    assert(grown == NULL, "Block resized to zero still returned\n");
+    assert(allocated(allocator) == 0, "Block resized to zero not freed, allocated: %zu\n", allocated(allocator));
+
+    // a null pointer is resized to a fresh block, like realloc
+    char *fresh = resize(char, 32, 0, NULL, allocator);
+    assert(fresh != NULL, "Null pointer not resized to a fresh block\n");
+    assert(allocated(allocator) == 32, "Unexpected allocated memory: %zu\n", allocated(allocator));
+    release(char, 32, fresh, allocator);
+
+    // over-aligned memory is aligned both on top of the arena and out of the free list, the padding is reused
+    arena_free_all(&arena);
+
+    char *unaligned = make(char, 16, allocator);
+    double *line = make_aligned(double, 8, 64, allocator);
+    assert((uintptr_t)line % 64 == 0, "Memory not aligned to 64 bytes: %p\n", (void *)line);
+
+    char *in_padding = make(char, 32, allocator);
+    assert(in_padding == unaligned + 16, "Alignment padding not reused\n");
+
+    char *page = make_aligned(char, 100, 4096, allocator);
+    assert((uintptr_t)page % 4096 == 0, "Memory not aligned to 4096 bytes: %p\n", (void *)page);
+    release(char, 100, page, allocator);
+
+    page = make_aligned(char, 100, 4096, allocator);
+    assert((uintptr_t)page % 4096 == 0, "Reused memory not aligned to 4096 bytes: %p\n", (void *)page);
+
+    release(char, 100, page, allocator);
+    release(char, 32, in_padding, allocator);
+    release(double, 8, line, allocator);
+    release(char, 16, unaligned, allocator);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // batches are carved with a single bump, freed blocks of the same size are reused by the next batch
+    arena_free_all(&arena);
+
+    void *batch[100];
+    size_t carved = arena_alloc_batch(100, sizeof(Data), batch, &arena);
+    assert(carved == 100, "Expected 100 blocks, carved: %zu\n", carved);
+    size_t stride = (sizeof(Data) + DEFAULT_ALLIGNMENT - 1) & ~(DEFAULT_ALLIGNMENT - 1);
+    for (int i = 1; i < 100; i += 1) {
+        assert((char *)batch[i] == (char *)batch[i - 1] + stride, "Block %d not carved contiguously\n", i);
+    }
+    assert(allocated(allocator) == 100 * sizeof(Data), "Unexpected allocated: %zu\n", allocated(allocator));
+
+    char *after_batch = make(char, 16, allocator);
+    void *middle[10];
+    for (int i = 0; i < 10; i += 1)
+        middle[i] = batch[20 + i];
+    arena_free_batch(10, sizeof(Data), middle, &arena);
+
+    void *reused_batch[10];
+    carved = arena_alloc_batch(10, sizeof(Data), reused_batch, &arena);
+    assert(carved == 10, "Expected 10 blocks, carved: %zu\n", carved);
+    for (int i = 0; i < 10; i += 1) {
+        assert((char *)reused_batch[i] >= (char *)batch[20] && (char *)reused_batch[i] <= (char *)batch[29],
+               "Freed block not reused: %d\n", i);
+        batch[20 + i] = reused_batch[i];
+    }
+
+    // freed backwards from the top, the whole batch rewinds the offset
+    release(char, 16, after_batch, allocator);
+    arena_free_batch(100, sizeof(Data), batch, &arena);
+    assert(arena.offset == 0, "Batch not rewound, offset: %zu\n", arena.offset);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // the biggest blocks are indexed by size, the smallest one that fits is reused whatever the free order
+    arena_free_all(&arena);
+
+    size_t huge_sizes[6] = {8192, 5000, 65536, 6000, 4096, 20000};
+    char *huge[6];
+    char *guards[6];
+    for (int i = 0; i < 6; i += 1) {
+        huge[i] = make(char, huge_sizes[i], allocator);
+        guards[i] = make(char, 16, allocator);
+    }
+    for (int i = 0; i < 6; i += 1)
+        release(char, huge_sizes[i], huge[i], allocator);
+
+    char *fit = make(char, 5500, allocator);
+    assert(fit == huge[3], "Smallest fitting block not reused for 5500 bytes\n");
+    char *exact = make(char, 4096, allocator);
+    assert(exact == huge[4], "Exact block not reused for 4096 bytes\n");
+    char *larger = make(char, 10000, allocator);
+    assert(larger == huge[5], "Smallest fitting block not reused for 10000 bytes\n");
+
+    release(char, 10000, larger, allocator);
+    release(char, 4096, exact, allocator);
+    release(char, 5500, fit, allocator);
+    for (int i = 0; i < 6; i += 1)
+        release(char, 16, guards[i], allocator);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // a block of the exact bin is reused first, its bin leaves the bitmap once empty
+    arena_free_all(&arena);
+
+    char *small[3];
+    for (int i = 0; i < 3; i += 1) {
+        small[i] = make(char, 48 + 16 * i, allocator);
+        guards[i] = make(char, 16, allocator);
+    }
+    for (int i = 0; i < 3; i += 1)
+        release(char, 48 + 16 * i, small[i], allocator);
+
+    char *exact_bin = make(char, 64, allocator);
+    assert(exact_bin == small[1], "Block of the exact bin not reused for 64 bytes\n");
+    assert(!(arena.free_list.map & ((uint64_t)1 << (64 / FREE_LIST_BIN_STEP - 1))),
+           "Empty exact bin left in the map\n");
+
+    // a geometric bin holds a range of sizes, a block too small in the bin of the request moves the search to the next
+    // bin, across the power of two
+    arena_free_all(&arena);
+
+    char *below = make(char, 960, allocator);
+    guards[0] = make(char, 16, allocator);
+    char *above = make(char, 1024, allocator);
+    guards[1] = make(char, 16, allocator);
+    release(char, 960, below, allocator);
+    release(char, 1024, above, allocator);
+
+    char *crossed = make(char, 1000, allocator);
+    assert(crossed == above, "Block of the next power of two not reused for 1000 bytes\n");
+
+    // a block taken from a bigger bin is split, the tail goes back to the free list and serves the next request
+    arena_free_all(&arena);
+
+    char *big = make(char, 2048, allocator);
+    guards[0] = make(char, 16, allocator);
+    release(char, 2048, big, allocator);
+    size_t offset = arena.offset;
+
+    char *head = make(char, 256, allocator);
+    char *tail = make(char, 1792, allocator);
+    assert(head == big && tail == big + 256, "Block not split, head: %p, tail: %p\n", (void *)head, (void *)tail);
+    assert(arena.offset == offset, "Split block not reused, offset: %zu\n", arena.offset);
+    assert(!arena.free_list.map && !arena.free_list.tree, "Free blocks left after the split\n");
+
+    // the request fits the block at the head of its bin, best fit takes it while first fit starts at the next bin
+    for (int strategy = 0; strategy < 2; strategy += 1) {
+        arena = arena_init(buffer, size, DEFAULT_ALLIGNMENT, strategy ? FirstFit : BestFit);
+
+        char *same_bin = make(char, 1008, allocator);
+        guards[0] = make(char, 16, allocator);
+        char *next_bin = make(char, 1024, allocator);
+        guards[1] = make(char, 16, allocator);
+        release(char, 1024, next_bin, allocator);
+        release(char, 1008, same_bin, allocator);
+
+        char *picked = make(char, 1000, allocator);
+        assert(picked == (strategy ? next_bin : same_bin), "%s picked the wrong block for 1000 bytes\n",
+               strategy ? "FirstFit" : "BestFit");
+    }
+
     free(buffer);
     buffer = NULL;
 
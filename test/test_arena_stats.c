@@ -0,0 +1,90 @@
+#include "../src/arena.h"
+#include "../src/utils.h"
+
+int main(void) {
+
+    size_t size = 64 * 1024;
+    void *buffer = malloc(size);
+    Arena arena = arena_init(buffer, size, DEFAULT_ALLIGNMENT, BestFit);
+    Allocator allocator = arena_alloc_init(&arena);
+
+    ArenaStats stats;
+    arena_stats(&arena, &stats);
+    assert(stats.available == size, "Unexpected available memory: %zu\n", stats.available);
+    assert(stats.fragmentation == 0.0, "Empty arena fragmented: %f\n", stats.fragmentation);
+
+    char *small = make(char, 24, allocator);
+    char *medium = make(char, 100, allocator);
+    char *large = make(char, 1000, allocator);
+    char *huge = make(char, 5000, allocator);
+    char *guard = make(char, 16, allocator);
+
+    arena_stats(&arena, &stats);
+    assert(stats.reuse_misses[Small] == 2, "Expected 2 small misses, misses: %zu\n", stats.reuse_misses[Small]);
+    assert(stats.reuse_misses[Medium] == 1, "Expected 1 medium miss, misses: %zu\n", stats.reuse_misses[Medium]);
+    assert(stats.reuse_misses[Large] == 1, "Expected 1 large miss, misses: %zu\n", stats.reuse_misses[Large]);
+    assert(stats.reuse_misses[Huge] == 1, "Expected 1 huge miss, misses: %zu\n", stats.reuse_misses[Huge]);
+    // 24, 100, 1000 and 5000 bytes leave 8, 12, 8 and 8 bytes of padding before the next aligned block
+    assert(stats.padding == 36, "Expected 36 bytes of padding, padding: %zu\n", stats.padding);
+
+    release(char, 100, medium, allocator);
+    release(char, 5000, huge, allocator);
+
+    arena_stats(&arena, &stats);
+    assert(stats.free_blocks[Medium] == 1, "Expected 1 medium free block, blocks: %zu\n", stats.free_blocks[Medium]);
+    assert(stats.free_bytes[Medium] == 112, "Expected 112 medium free bytes, bytes: %zu\n", stats.free_bytes[Medium]);
+    assert(stats.free_blocks[Huge] == 1, "Expected 1 huge free block, blocks: %zu\n", stats.free_blocks[Huge]);
+    assert(stats.largest_free_block == 5008, "Unexpected largest free block: %zu\n", stats.largest_free_block);
+    assert(stats.fragmentation > 0.0 && stats.fragmentation < 1.0, "Unexpected fragmentation: %f\n",
+           stats.fragmentation);
+
+    medium = make(char, 100, allocator);
+    arena_stats(&arena, &stats);
+    assert(stats.reuse_hits[Medium] == 1, "Expected 1 medium hit, hits: %zu\n", stats.reuse_hits[Medium]);
+    assert(stats.free_blocks[Medium] == 0, "Medium free block not reused\n");
+
+    // the high water mark stays where the offset went, even once the top of the arena is freed
+    size_t high_water = arena.offset;
+    release(char, 16, guard, allocator);
+    arena_coalesce(&arena);
+    arena_stats(&arena, &stats);
+    assert(stats.offset < high_water, "Offset not rewound: %zu\n", stats.offset);
+    assert(stats.high_water == high_water, "Expected high water %zu, got: %zu\n", high_water, stats.high_water);
+
+    release(char, 1000, large, allocator);
+    release(char, 100, medium, allocator);
+    release(char, 24, small, allocator);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // the upper bound of each class is inclusive
+    ArenaStats before;
+    arena_stats(&arena, &before);
+    char *bounds[3] = {make(char, 64, allocator), make(char, 512, allocator), make(char, 4096, allocator)};
+    guard = make(char, 16, allocator);
+    arena_stats(&arena, &stats);
+    BlockClass classes[3] = {Small, Medium, Large};
+    for (int i = 0; i < 3; i += 1) {
+        size_t requests = stats.reuse_hits[classes[i]] + stats.reuse_misses[classes[i]] -
+                          before.reuse_hits[classes[i]] - before.reuse_misses[classes[i]];
+        assert(requests == (classes[i] == Small ? 2 : 1), "Unexpected requests in class %d: %zu\n", classes[i],
+               requests);
+    }
+
+    arena_stats(&arena, &before);
+    release(char, 4096, bounds[2], allocator);
+    arena_stats(&arena, &stats);
+    assert(stats.free_blocks[Large] == before.free_blocks[Large] + 1, "Free block of 4096 bytes not large\n");
+    assert(stats.free_blocks[Huge] == before.free_blocks[Huge], "Free block of 4096 bytes counted as huge\n");
+
+    release(char, 16, guard, allocator);
+    release(char, 512, bounds[1], allocator);
+    release(char, 64, bounds[0], allocator);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    free(buffer);
+    buffer = NULL;
+
+    info("Arena stats test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include "../src/concurrent_arena.h"
+#include "../src/utils.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#define THREADS 8
+#define SLOTS 256
+#define ROUNDS 20000
+#define APPENDS 4096
+#define RACES 200
+#define RACE_APPENDS 16
+#define WIDE_ALIGNMENT 64
+
+typedef struct {
+    Allocator *allocator;
+    unsigned int seed;
+    int failed;
+} Worker;
+
+static unsigned int next_random(unsigned int *seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) & 0x7fff;
+}
+
+static void *worker_run(void *arg) {
+    Worker *worker = (Worker *)arg;
+    Allocator allocator = *worker->allocator;
+
+    uint8_t *slots[SLOTS] = {0};
+    size_t sizes[SLOTS] = {0};
+    uint8_t tag = (uint8_t)worker->seed;
+
+    for (int round = 0; round < ROUNDS; round += 1) {
+        int i = next_random(&worker->seed) % SLOTS;
+        if (slots[i]) {
+            for (size_t k = 0; k < sizes[i]; k += 1) {
+                if (slots[i][k] != tag) {
+                    worker->failed = 1;
+                    return 0;
+                }
+            }
+            release(uint8_t, sizes[i], slots[i], allocator);
+            slots[i] = NULL;
+        } else {
+            // mostly cached sizes, with a few blocks going to the central arena
+            sizes[i] = 1 + next_random(&worker->seed) % (i % 8 ? 512 : 2048);
+            slots[i] = make(uint8_t, sizes[i], allocator);
+            if (!slots[i]) {
+                worker->failed = 1;
+                return 0;
+            }
+            memset(slots[i], tag, sizes[i]);
+        }
+    }
+
+    for (int i = 0; i < SLOTS; i += 1) {
+        if (slots[i]) {
+            release(uint8_t, sizes[i], slots[i], allocator);
+        }
+    }
+
+    return 0;
+}
+
+typedef struct {
+    Allocator *allocator;
+    uint8_t *blocks[APPENDS];
+    size_t sizes[APPENDS];
+    unsigned int seed;
+    uint8_t tag;
+} Appender;
+
+static void *appender_run(void *arg) {
+    Appender *appender = (Appender *)arg;
+    Allocator allocator = *appender->allocator;
+
+    for (int i = 0; i < APPENDS; i += 1) {
+        appender->sizes[i] = 1 + next_random(&appender->seed) % 256;
+        appender->blocks[i] = make(uint8_t, appender->sizes[i], allocator);
+        if (appender->blocks[i]) {
+            memset(appender->blocks[i], appender->tag, appender->sizes[i]);
+        }
+    }
+
+    return 0;
+}
+
+typedef struct {
+    Allocator *allocator;
+    int *start;
+    int failed;
+} Racer;
+
+static void *racer_run(void *arg) {
+    Racer *racer = (Racer *)arg;
+    Allocator allocator = *racer->allocator;
+
+    while (!__atomic_load_n(racer->start, __ATOMIC_ACQUIRE))
+        continue;
+    for (int i = 0; i < RACE_APPENDS; i += 1) {
+        uint8_t *block = make(uint8_t, 1 + (size_t)i * 7, allocator);
+        if (!block || (uintptr_t)block % WIDE_ALIGNMENT) {
+            racer->failed = 1;
+        }
+    }
+
+    return 0;
+}
+
+int main(void) {
+
+    size_t size = 1024 * 1024 * 64;
+
+    void *buffer = malloc(size);
+
+    ConcurrentArena arena;
+    int err = concurrent_arena_init(&arena, arena_init(buffer, size, DEFAULT_ALLIGNMENT, BestFit));
+    assert(err == 0, "Failed to initialize the concurrent arena: %d\n", err);
+
+    Allocator allocator = concurrent_arena_alloc_init(&arena);
+
+    pthread_t threads[THREADS];
+    Worker workers[THREADS];
+    for (int i = 0; i < THREADS; i += 1) {
+        workers[i] = (Worker){.allocator = &allocator, .seed = (unsigned int)i + 1, .failed = 0};
+        pthread_create(&threads[i], NULL, worker_run, &workers[i]);
+    }
+
+    for (int i = 0; i < THREADS; i += 1) {
+        pthread_join(threads[i], NULL);
+        assert(!workers[i].failed, "Worker %d found corrupted memory\n", i);
+    }
+
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+    assert(arena.caches == NULL, "Thread caches not released\n");
+
+    // like realloc, a null pointer allocates and a size of zero frees the block
+    uint8_t *resized = resize(uint8_t, 8, 0, NULL, allocator);
+    assert(resized != NULL, "Null pointer not resized to a fresh block\n");
+    assert(resize(uint8_t, 0, 8, resized, allocator) == NULL, "Block resized to zero still returned\n");
+    assert(allocated(allocator) == 0, "Block resized to zero not freed, allocated: %zu\n", allocated(allocator));
+    concurrent_arena_flush(&arena);
+    // the batches of the exited threads wait in the central lists until they are trimmed
+    concurrent_arena_trim(&arena);
+    assert(arena_allocated(&arena.arena) == 0, "Blocks left in thread caches, allocated: %zu\n",
+           arena_allocated(&arena.arena));
+
+    concurrent_arena_destroy(&arena);
+
+    free(buffer);
+    buffer = NULL;
+
+    // append-only arena shared by every thread without locks, committing its pages on the way
+    Arena shared = arena_init_virtual(size, 4096, DEFAULT_ALLIGNMENT, BestFit);
+    Allocator shared_allocator = arena_atomic_alloc_init(&shared);
+
+    pthread_t appender_threads[THREADS];
+    Appender *appenders = malloc(sizeof(Appender) * THREADS);
+    for (int i = 0; i < THREADS; i += 1) {
+        appenders[i].allocator = &shared_allocator;
+        appenders[i].seed = (unsigned int)i + 1;
+        appenders[i].tag = (uint8_t)i + 1;
+        pthread_create(&appender_threads[i], NULL, appender_run, &appenders[i]);
+    }
+
+    size_t appended = 0;
+    for (int i = 0; i < THREADS; i += 1) {
+        pthread_join(appender_threads[i], NULL);
+        for (int j = 0; j < APPENDS; j += 1) {
+            uint8_t *block = appenders[i].blocks[j];
+            assert(block != NULL, "Append %d of thread %d failed\n", j, i);
+            assert((uintptr_t)block % DEFAULT_ALLIGNMENT == 0, "Unaligned block %p\n", (void *)block);
+            for (size_t k = 0; k < appenders[i].sizes[j]; k += 1)
+                assert(block[k] == appenders[i].tag, "Overlapping blocks at %p\n", (void *)block);
+            appended += appenders[i].sizes[j];
+        }
+    }
+
+    assert(allocated(shared_allocator) == appended, "Expected %zu allocated, allocated: %zu\n", appended,
+           allocated(shared_allocator));
+    assert(resize(uint8_t, 0, appenders[0].sizes[0], appenders[0].blocks[0], shared_allocator) == NULL,
+           "Block resized to zero still returned\n");
+    assert(allocated(shared_allocator) == appended - appenders[0].sizes[0], "Block resized to zero not accounted\n");
+    assert(shared.mapped >= shared.offset, "Offset past committed memory: %zu\n", shared.offset);
+
+    free(appenders);
+    arena_destroy(&shared);
+
+    // the first reservations from an unaligned buffer race on its padding, every block must still be aligned
+    buffer = malloc(64 * 1024 + 1);
+    for (int race = 0; race < RACES; race += 1) {
+        Arena unaligned = arena_init((uint8_t *)buffer + 1, 64 * 1024, WIDE_ALIGNMENT, BestFit);
+        Allocator unaligned_allocator = arena_atomic_alloc_init(&unaligned);
+        int start = 0;
+        pthread_t racer_threads[THREADS];
+        Racer racers[THREADS];
+        for (int i = 0; i < THREADS; i += 1) {
+            racers[i] = (Racer){.allocator = &unaligned_allocator, .start = &start, .failed = 0};
+            pthread_create(&racer_threads[i], NULL, racer_run, &racers[i]);
+        }
+        __atomic_store_n(&start, 1, __ATOMIC_RELEASE);
+        for (int i = 0; i < THREADS; i += 1) {
+            pthread_join(racer_threads[i], NULL);
+            assert(!racers[i].failed, "Thread %d got an unaligned block in race %d\n", i, race);
+        }
+    }
+    free(buffer);
+    buffer = NULL;
+
+    info("Concurrent arena test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#define _DEFAULT_SOURCE
+
+#include "../src/frame_arena.h"
+#include "../src/utils.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#define READERS 4
+#define TICKS 2000
+#define VALUES 256
+
+typedef struct {
+    FrameArena *frames;
+    size_t **published;
+    size_t index;
+    size_t reads;
+    int done;
+    int failed;
+} Reader;
+
+static void *reader_run(void *arg) {
+    Reader *reader = (Reader *)arg;
+
+    while (!__atomic_load_n(&reader->done, __ATOMIC_ACQUIRE)) {
+        size_t epoch = frame_arena_enter(reader->frames, reader->index);
+        if (epoch > 0) {
+            size_t *values = __atomic_load_n(&reader->published[epoch - 1], __ATOMIC_ACQUIRE);
+            for (size_t i = 0; i < VALUES; i += 1) {
+                if (values[i] != epoch - 1) {
+                    reader->failed = 1;
+                }
+            }
+            reader->reads++;
+        }
+        frame_arena_leave(reader->frames, reader->index);
+    }
+
+    return 0;
+}
+
+typedef struct {
+    FrameArena *frames;
+    int entered;
+    int finished;
+} Holder;
+
+static void *holder_run(void *arg) {
+    Holder *holder = (Holder *)arg;
+
+    frame_arena_enter(holder->frames, 0);
+    __atomic_store_n(&holder->entered, 1, __ATOMIC_RELEASE);
+    usleep(50000);
+    __atomic_store_n(&holder->finished, 1, __ATOMIC_RELEASE);
+    frame_arena_leave(holder->frames, 0);
+
+    return 0;
+}
+
+int main(void) {
+
+    size_t size = 64 * 1024;
+    void *buffer = malloc(2 * size);
+
+    Arena arenas[2] = {
+        arena_init(buffer, size, DEFAULT_ALLIGNMENT, BestFit),
+        arena_init((char *)buffer + size, size, DEFAULT_ALLIGNMENT, BestFit),
+    };
+    FrameArena frames;
+    int err = frame_arena_init(&frames, arenas, 2);
+    assert(err == 0, "Failed to initialize the frame arena: %d\n", err);
+    Allocator allocator = frame_arena_alloc_init(&frames);
+
+    // each tick fills one arena while readers go through the previous tick, nothing is ever freed one by one
+    size_t **published = calloc(TICKS, sizeof(size_t *));
+    pthread_t threads[READERS];
+    Reader readers[READERS];
+    for (int r = 0; r < READERS; r += 1) {
+        readers[r] = (Reader){.frames = &frames, .published = published, .index = (size_t)r};
+        pthread_create(&threads[r], NULL, reader_run, &readers[r]);
+    }
+
+    for (size_t tick = 0; tick < TICKS; tick += 1) {
+        size_t *values = make(size_t, VALUES, allocator);
+        assert(values != NULL, "Tick %zu not allocated\n", tick);
+        for (size_t i = 0; i < VALUES; i += 1)
+            values[i] = tick;
+        __atomic_store_n(&published[tick], values, __ATOMIC_RELEASE);
+        frame_arena_advance(&frames);
+    }
+
+    size_t reads = 0;
+    for (int r = 0; r < READERS; r += 1) {
+        __atomic_store_n(&readers[r].done, 1, __ATOMIC_RELEASE);
+        pthread_join(threads[r], NULL);
+        assert(!readers[r].failed, "Reader %d saw a tick reclaimed under it\n", r);
+        reads += readers[r].reads;
+    }
+    assert(reads > 0, "No tick read\n");
+    assert(allocated(allocator) == VALUES * sizeof(size_t), "Arenas not reset, allocated: %zu\n",
+           allocated(allocator));
+
+    // the arena of a tick is only reset once its reader left, the producer waits for it
+    Holder holder = {.frames = &frames, .entered = 0, .finished = 0};
+    pthread_t holder_thread;
+    pthread_create(&holder_thread, NULL, holder_run, &holder);
+    while (!__atomic_load_n(&holder.entered, __ATOMIC_ACQUIRE))
+        sched_yield();
+
+    frame_arena_advance(&frames);
+    assert(__atomic_load_n(&holder.finished, __ATOMIC_ACQUIRE), "Tick reset while its reader was still in\n");
+    pthread_join(holder_thread, NULL);
+
+    frame_arena_destroy(&frames);
+    free(published);
+    free(buffer);
+    buffer = NULL;
+
+    info("Frame arena test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "../src/arena.h"
+#include "../src/utils.h"
+
+#include <string.h>
+
+int main(void) {
+
+    size_t size = 8 * HUGE_PAGE_SIZE;
+
+    // explicit huge pages need a reserved pool, any of the fallbacks is fine as long as it is reported
+    Arena arena = arena_init_huge(size, HugePages2M, DEFAULT_ALLIGNMENT, BestFit);
+    assert(arena.base != NULL, "Failed to map %zu bytes\n", size);
+    assert(arena.backing == MappedBacking, "Unexpected backing: %d\n", arena.backing);
+    assert(arena.pages <= HugePages2M, "Unexpected pages: %d\n", arena.pages);
+    assert(arena.size >= size, "Arena smaller than requested: %zu\n", arena.size);
+    if (arena.pages != DefaultPages) {
+        assert((uintptr_t)arena.base % HUGE_PAGE_SIZE == 0, "Huge pages not aligned: %p\n", arena.base);
+        assert(arena.size % HUGE_PAGE_SIZE == 0, "Size not rounded to huge pages: %zu\n", arena.size);
+    }
+    info("Huge arena backed by pages: %d\n", arena.pages);
+
+    Allocator allocator = arena_alloc_init(&arena);
+
+    char *blocks[16];
+    for (int i = 0; i < 16; i += 1) {
+        blocks[i] = make(char, size / 32, allocator);
+        assert(blocks[i] != NULL, "Failed to allocate block %d\n", i);
+        memset(blocks[i], 'a' + i, size / 32);
+    }
+    for (int i = 0; i < 16; i += 1) {
+        assert(blocks[i][size / 64] == 'a' + i, "Block %d corrupted\n", i);
+        release(char, size / 32, blocks[i], allocator);
+    }
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    arena_destroy(&arena);
+    assert(arena.base == NULL, "Arena not reset after destroy\n");
+
+    // base pages are mapped as a whole as well
+    arena = arena_init_huge(size, DefaultPages, DEFAULT_ALLIGNMENT, FirstFit);
+    assert(arena.base != NULL && arena.pages == DefaultPages, "Failed to map %zu bytes of base pages\n", size);
+    arena_destroy(&arena);
+
+    info("Huge arena test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "../src/numa_arena.h"
+#include "../src/utils.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define THREADS 4
+#define BLOCKS 1024
+
+typedef struct {
+    NumaArena *numa;
+    char *blocks[BLOCKS];
+    int failed;
+} Worker;
+
+static int owned_by_node(NumaArena *numa, void *ptr) {
+    for (size_t i = 0; i < numa->nodes; i += 1) {
+        Arena *a = &numa->arenas[i].arena;
+        if ((uintptr_t)ptr >= (uintptr_t)a->base && (uintptr_t)ptr < (uintptr_t)a->base + a->size) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *worker_run(void *arg) {
+    Worker *worker = (Worker *)arg;
+    Allocator allocator = numa_arena_alloc_init(worker->numa);
+
+    for (int i = 0; i < BLOCKS; i += 1) {
+        worker->blocks[i] = make(char, 16 + i % 1024, allocator);
+        if (!worker->blocks[i] || !owned_by_node(worker->numa, worker->blocks[i])) {
+            worker->failed = 1;
+            return 0;
+        }
+        memset(worker->blocks[i], 'a' + i % 26, 16 + i % 1024);
+    }
+    return 0;
+}
+
+int main(void) {
+
+    NumaArena numa;
+    int err = numa_arena_init(&numa, (size_t)1 << 30, 0, DEFAULT_ALLIGNMENT, BestFit);
+    assert(err == 0, "Failed to initialize the NUMA arena: %d\n", err);
+    assert(numa.nodes >= 1 && numa.nodes <= NUMA_MAX_NODES, "Unexpected number of nodes: %zu\n", numa.nodes);
+    assert(numa_arena_current_node(&numa) < numa.nodes, "Current node out of range\n");
+    info("NUMA arena with %zu nodes, bound: %d\n", numa.nodes, numa.bound);
+
+    Worker workers[THREADS];
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t += 1) {
+        workers[t] = (Worker){.numa = &numa};
+        pthread_create(&threads[t], 0, worker_run, &workers[t]);
+    }
+    for (int t = 0; t < THREADS; t += 1) {
+        pthread_join(threads[t], 0);
+        assert(!workers[t].failed, "Worker %d failed\n", t);
+    }
+
+    // the main thread frees the memory of the workers, each block goes back to its own node
+    Allocator allocator = numa_arena_alloc_init(&numa);
+    for (int t = 0; t < THREADS; t += 1) {
+        for (int i = 0; i < BLOCKS; i += 1) {
+            assert(workers[t].blocks[i][15] == 'a' + i % 26, "Block %d of worker %d corrupted\n", i, t);
+            release(char, 16 + i % 1024, workers[t].blocks[i], allocator);
+        }
+    }
+    numa_arena_flush(&numa);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    numa_arena_destroy(&numa);
+
+    // a node whose memory cannot be bound collapses the set to a single arena serving every thread
+    int node_ids[] = {0, NUMA_MAX_NODES - 1};
+    err = numa_arena_init_nodes(&numa, node_ids, 2, (size_t)1 << 30, 0, DEFAULT_ALLIGNMENT, BestFit);
+    assert(err == 0, "Failed to initialize the NUMA arena on two nodes: %d\n", err);
+    assert(numa.nodes == 1 && !numa.bound, "NUMA arena not collapsed, nodes: %zu, bound: %d\n", numa.nodes, numa.bound);
+    assert(numa_arena_current_node(&numa) == 0, "Thread not routed to the single arena\n");
+    char *block = make(char, 100, allocator);
+    assert(block != NULL && owned_by_node(&numa, block), "Collapsed NUMA arena not allocating\n");
+    release(char, 100, block, allocator);
+    numa_arena_flush(&numa);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+    numa_arena_destroy(&numa);
+
+    info("NUMA arena test passed\n");
+
+    return 0;
+}
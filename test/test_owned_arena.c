@@ -0,0 +1,100 @@
+#include "../src/owned_arena.h"
+#include "../src/utils.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CONSUMERS 4
+#define MESSAGES 2000
+#define ROUNDS 50
+
+typedef struct {
+    Allocator *allocator;
+    uint8_t **messages;
+    size_t *sizes;
+    int first;
+    int failed;
+} Consumer;
+
+static void *consumer_run(void *arg) {
+    Consumer *consumer = (Consumer *)arg;
+    Allocator allocator = *consumer->allocator;
+
+    for (int i = consumer->first; i < MESSAGES; i += CONSUMERS) {
+        for (size_t k = 0; k < consumer->sizes[i]; k += 1) {
+            if (consumer->messages[i][k] != (uint8_t)i) {
+                consumer->failed = 1;
+            }
+        }
+        release(uint8_t, consumer->sizes[i], consumer->messages[i], allocator);
+    }
+
+    return 0;
+}
+
+int main(void) {
+
+    size_t size = 1024 * 1024;
+    void *buffer = malloc(size);
+
+    // remote blocks cannot be stored in blocks aligned below them
+    Arena arena = arena_init(buffer, size, 4, BestFit);
+    OwnedArena owned;
+    int err = owned_arena_init(&owned, &arena);
+    assert(err == EINVAL, "Arena aligned below a remote block accepted: %d\n", err);
+
+    // an 8 byte alignment packs small messages, they are still big enough to be pushed
+    arena = arena_init(buffer, size, 8, BestFit);
+    err = owned_arena_init(&owned, &arena);
+    assert(err == 0, "Failed to initialize the owned arena: %d\n", err);
+    Allocator allocator = owned_arena_alloc_init(&owned);
+
+    uint8_t *messages[MESSAGES];
+    size_t sizes[MESSAGES];
+
+    // the owner produces messages, other threads consume and free them, the arena only fits a few rounds unless the
+    // next round reuses their memory
+    for (int round = 0; round < ROUNDS; round += 1) {
+        for (int i = 0; i < MESSAGES; i += 1) {
+            sizes[i] = 1 + (size_t)(i * 37) % 200;
+            messages[i] = make(uint8_t, sizes[i], allocator);
+            assert(messages[i] != NULL, "Message %d of round %d not allocated\n", i, round);
+            memset(messages[i], (uint8_t)i, sizes[i]);
+        }
+
+        pthread_t threads[CONSUMERS];
+        Consumer consumers[CONSUMERS];
+        for (int c = 0; c < CONSUMERS; c += 1) {
+            consumers[c] = (Consumer){
+                .allocator = &allocator, .messages = messages, .sizes = sizes, .first = c, .failed = 0};
+            pthread_create(&threads[c], NULL, consumer_run, &consumers[c]);
+        }
+        for (int c = 0; c < CONSUMERS; c += 1) {
+            pthread_join(threads[c], NULL);
+            assert(!consumers[c].failed, "Consumer %d found corrupted memory in round %d\n", c, round);
+        }
+
+        assert(allocated(allocator) == 0, "Remote frees not accounted, allocated: %zu\n", allocated(allocator));
+        assert(arena_allocated(&arena) != 0, "Remote frees reached the arena before a drain\n");
+    }
+
+    // remote blocks are given back on the next allocation of the owner
+    char *last = make(char, 8, allocator);
+    assert(owned.remote == NULL, "Remote frees not drained\n");
+    release(char, 8, last, allocator);
+    assert(arena_allocated(&arena) == 0, "Memory leak detected, allocated: %zu\n", arena_allocated(&arena));
+
+    // like realloc, a size of zero frees the block, the arena keeps none of it
+    last = make(char, 8, allocator);
+    assert(resize(char, 0, 8, last, allocator) == NULL, "Block resized to zero still returned\n");
+    assert(allocated(allocator) == 0 && arena_allocated(&arena) == 0, "Block resized to zero not freed\n");
+
+    free(buffer);
+    buffer = NULL;
+
+    info("Owned arena test passed\n");
+
+    return 0;
+}
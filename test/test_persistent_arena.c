@@ -0,0 +1,108 @@
+#define _DEFAULT_SOURCE
+
+#include "../src/arena.h"
+#include "../src/utils.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define COUNT 1000
+#define ARENA_PATH "target/test/output/test_persistent_arena.bin"
+#define OTHER_PATH "target/test/output/test_persistent_arena.other"
+
+// nodes link with offsets, so that the list survives the heap moving to another address
+typedef struct {
+    size_t next;
+    size_t value;
+} Node;
+
+/**
+ * @brief Check the list found from the root of the arena
+ *
+ * @param a arena holding the list
+ * @param count expected number of nodes
+ */
+static void check_list(Arena *a, size_t count) {
+    Node *head = arena_get_root(a);
+    assert(head != NULL, "Root not found\n");
+
+    size_t seen = 0;
+    for (Node *node = head; node; node = node->next ? arena_at(a, node->next - 1) : NULL) {
+        assert(node->value % 2 == 1, "Freed node still in the list: %zu\n", node->value);
+        seen++;
+    }
+    assert(seen == count, "Expected %zu nodes, found: %zu\n", count, seen);
+}
+
+int main(void) {
+
+    unlink(ARENA_PATH);
+
+    Arena arena = arena_init_file(ARENA_PATH, 1024 * 1024, DEFAULT_ALLIGNMENT, BestFit);
+    assert(arena.base != NULL, "Cannot create %s\n", ARENA_PATH);
+    assert(arena.backing == FileBacking, "Unexpected backing: %d\n", arena.backing);
+    Allocator allocator = arena_alloc_init(&arena);
+
+    // odd nodes are linked, even ones are freed to leave holes in the free list
+    Node *nodes[COUNT];
+    size_t head = 0;
+    for (size_t i = 0; i < COUNT; i += 1) {
+        nodes[i] = make(Node, 1, allocator);
+        nodes[i]->value = i;
+        if (i % 2) {
+            nodes[i]->next = head;
+            head = arena_offset_of(&arena, nodes[i]) + 1;
+        }
+    }
+    char *big = make(char, 10000, allocator);
+    make(char, 16, allocator);
+    release(char, 10000, big, allocator);
+    for (size_t i = 0; i < COUNT; i += 2)
+        release(Node, 1, nodes[i], allocator);
+    arena_set_root(&arena, arena_at(&arena, head - 1));
+
+    size_t offset = arena.offset;
+    size_t committed = allocated(allocator);
+    void *base = arena.base;
+    arena_destroy(&arena);
+
+    // reopened at the same address, the heap is back as it was
+    arena = arena_init_file(ARENA_PATH, 0, 0, FirstFit);
+    assert(arena.base == base, "Heap not mapped back at %p\n", base);
+    assert(arena.strategy == BestFit && arena.align == DEFAULT_ALLIGNMENT, "Parameters not restored\n");
+    assert(arena.offset == offset, "Offset not restored: %zu\n", arena.offset);
+    assert(allocated(allocator) == committed, "Accounting not restored: %zu\n", allocated(allocator));
+    check_list(&arena, COUNT / 2);
+    assert(make(Node, 1, allocator) == nodes[COUNT - 2], "Free list not restored\n");
+    arena_destroy(&arena);
+
+    // with the previous address taken, the heap moves and the free list follows it
+    void *taken = mmap(base, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(taken != MAP_FAILED, "Cannot map the previous address\n");
+
+    arena = arena_init_file(ARENA_PATH, 0, 0, BestFit);
+    assert(arena.base != NULL && arena.base != base, "Heap not moved\n");
+    size_t delta = (size_t)((char *)arena.base - (char *)base);
+    check_list(&arena, COUNT / 2);
+
+    char *reused_big = make(char, 9000, allocator);
+    assert((char *)reused_big - delta == big, "Huge free block not relocated\n");
+    Node *reused = make(Node, 1, allocator);
+    assert((char *)reused - delta == (char *)nodes[COUNT - 4], "Free list not relocated\n");
+    release(Node, 1, reused, allocator);
+    release(char, 9000, reused_big, allocator);
+    arena_destroy(&arena);
+    munmap(taken, 4096);
+
+    // other files are not taken for arenas
+    FILE *file = fopen(OTHER_PATH, "w");
+    assert(file != NULL, "Cannot create %s\n", OTHER_PATH);
+    for (int i = 0; i < 2 * ARENA_FILE_HEADER_SIZE; i += 1)
+        fputc('x', file);
+    fclose(file);
+    assert(arena_init_file(OTHER_PATH, 4096, DEFAULT_ALLIGNMENT, BestFit).base == NULL, "Foreign file opened\n");
+
+    info("Persistent arena test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "../src/pool.h"
+#include "../src/memdump.h"
+#include "../src/utils.h"
+
+typedef struct Node {
+    struct Node *next;
+    int value;
+} Node;
+
+int main(void) {
+
+    size_t slab_slots = 8;
+    size_t size = sizeof(Node) * slab_slots * 4;
+
+    void *buffer = malloc(size);
+
+    Arena arena = arena_init(buffer, size, DEFAULT_ALLIGNMENT, BestFit);
+    Pool pool = pool_init(&arena, sizeof(Node), slab_slots);
+    Allocator allocator = pool_alloc_init(&pool);
+
+    Node *head = NULL;
+    for (size_t i = 0; i < slab_slots * 4; i += 1) {
+        Node *node = make(Node, 1, allocator);
+        assert(node != NULL, "pool_alloc failed at %zu\n", i);
+        node->value = (int)i;
+        node->next = head;
+        head = node;
+    }
+
+    assert(make(Node, 1, allocator) == NULL, "pool should have failed to allocate memory\n");
+    assert(make(char, sizeof(Node) + 1, allocator) == NULL, "pool should not serve sizes over the slot size\n");
+
+    hexDump("arena", buffer, size);
+
+    // freed slots are reused in LIFO order
+    Node *second = head->next;
+    Node *third = second->next;
+    release(Node, 1, head, allocator);
+    release(Node, 1, second, allocator);
+    assert(make(Node, 1, allocator) == second, "Freed slot not reused\n");
+    assert(make(Node, 1, allocator) == head, "Freed slot not reused\n");
+    second->next = third;
+    head->next = second;
+
+    while (head) {
+        Node *next = head->next;
+        release(Node, 1, head, allocator);
+        head = next;
+    }
+
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // like realloc, a null pointer takes a slot and a size of zero gives it back
+    head = resize(Node, 1, 0, NULL, allocator);
+    assert(head != NULL && allocated(allocator) == sizeof(Node), "Null pointer not resized to a slot\n");
+    assert(resize(Node, 0, 1, head, allocator) == NULL, "Slot resized to zero still returned\n");
+    assert(allocated(allocator) == 0, "Slot resized to zero not freed, allocated: %zu\n", allocated(allocator));
+
+    arena_free_all(&arena);
+
+    free(buffer);
+    buffer = NULL;
+
+    info("Pool test passed\n");
+
+    return 0;
+}
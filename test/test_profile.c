@@ -0,0 +1,181 @@
+#include "../src/arena.h"
+#include "../src/profile.h"
+#include "../src/utils.h"
+
+#include <string.h>
+
+#define PROFILE_PATH "target/test/output/test_profile.heap"
+#define NODES 100
+#define BLOBS 10
+#define ROUNDS 20000
+#define ROUND_SIZE 8192
+
+// Return address of the allocation site, the frame following it in the profile
+static void *site_caller = NULL;
+
+/**
+ * @brief Allocation site the profile must point back to
+ */
+static __attribute__((noinline)) void *allocate_node(Allocator allocator) {
+    site_caller = __builtin_return_address(0);
+    char *node = make(char, 64, allocator);
+    // keeps the call from becoming a tail call that would drop this frame
+    __asm__ volatile("" ::: "memory");
+    return node;
+}
+
+/**
+ * @brief Sum the sampled counters of every stack
+ */
+static void profile_totals(HeapProfiler *p, uint64_t totals[4]) {
+    memset(totals, 0, 4 * sizeof(uint64_t));
+    for (size_t i = 0; i < p->stack_capacity; i += 1) {
+        if (p->stacks[i]) {
+            totals[0] += p->stacks[i]->inuse_objects;
+            totals[1] += p->stacks[i]->inuse_bytes;
+            totals[2] += p->stacks[i]->alloc_objects;
+            totals[3] += p->stacks[i]->alloc_bytes;
+        }
+    }
+}
+
+int main(void) {
+
+    size_t size = 1024 * 1024;
+    void *buffer = malloc(size);
+    Arena arena = arena_init(buffer, size, DEFAULT_ALLIGNMENT, BestFit);
+
+    // a rate of 1 samples every allocation, each call site gets its own stack
+    HeapProfiler profiler;
+    assert(profiler_init(&profiler, arena_alloc_init(&arena), 1) == 0, "Cannot initialize the profiler\n");
+    Allocator allocator = profiler_alloc_init(&profiler);
+
+    char *nodes[NODES];
+    for (int i = 0; i < NODES; i += 1)
+        nodes[i] = allocate_node(allocator);
+    char *blobs[BLOBS];
+    for (int i = 0; i < BLOBS; i += 1)
+        blobs[i] = make(char, 1000, allocator);
+    for (int i = 0; i < NODES; i += 2)
+        release(char, 64, nodes[i], allocator);
+
+    uint64_t totals[4];
+    profile_totals(&profiler, totals);
+    assert(totals[0] == NODES / 2 + BLOBS && totals[1] == NODES / 2 * 64 + BLOBS * 1000,
+           "Unexpected in-use profile: %llu objects, %llu bytes\n", (unsigned long long)totals[0],
+           (unsigned long long)totals[1]);
+    assert(totals[2] == NODES + BLOBS && totals[3] == NODES * 64 + BLOBS * 1000,
+           "Unexpected allocated profile: %llu objects, %llu bytes\n", (unsigned long long)totals[2],
+           (unsigned long long)totals[3]);
+    assert(profiler.sampler.live == NODES / 2 + BLOBS, "Unexpected live samples: %zu\n", profiler.sampler.live);
+
+#if defined(__GLIBC__)
+    // the innermost frame of the nodes is the allocation site, not the profiler
+    int found = 0;
+    for (size_t i = 0; i < profiler.stack_capacity; i += 1) {
+        ProfileStack *stack = profiler.stacks[i];
+        if (stack && stack->alloc_objects == NODES) {
+            found = stack->depth > 1 && stack->frames[1] == site_caller;
+        }
+    }
+    assert(found, "Allocation site not at the top of its stack\n");
+#endif
+
+    // the profile starts with the totals and the sampling rate, then a line per stack
+    assert(profiler_write(&profiler, PROFILE_PATH) == 0, "Cannot write %s\n", PROFILE_PATH);
+    FILE *file = fopen(PROFILE_PATH, "r");
+    assert(file != NULL, "Cannot read %s\n", PROFILE_PATH);
+    char line[1024];
+    assert(fgets(line, sizeof(line), file) != NULL, "Empty profile\n");
+    char expected[128];
+    snprintf(expected, sizeof(expected), "heap profile: %d: %d [%d: %d] @ heap_v2/1\n", NODES / 2 + BLOBS,
+             NODES / 2 * 64 + BLOBS * 1000, NODES + BLOBS, NODES * 64 + BLOBS * 1000);
+    assert(strcmp(line, expected) == 0, "Unexpected header: %s", line);
+    size_t stacks = 0;
+    while (fgets(line, sizeof(line), file) && strchr(line, '@'))
+        stacks++;
+    assert(stacks == profiler.stack_count, "Expected %zu stacks, read: %zu\n", profiler.stack_count, stacks);
+    fclose(file);
+
+    for (int i = 1; i < NODES; i += 2)
+        release(char, 64, nodes[i], allocator);
+    for (int i = 0; i < BLOBS; i += 1)
+        release(char, 1000, blobs[i], allocator);
+    profile_totals(&profiler, totals);
+    assert(totals[0] == 0 && totals[1] == 0 && profiler.sampler.live == 0, "Samples left in use\n");
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // a reallocated block keeps its sample, grown to the new size
+    uint64_t before[4];
+    profile_totals(&profiler, before);
+    char *grown = make(char, 100, allocator);
+    grown = resize(char, 300, 100, grown, allocator);
+    profile_totals(&profiler, totals);
+    assert(totals[0] == 1 && totals[1] == 300, "Unexpected in-use profile after realloc: %llu objects, %llu bytes\n",
+           (unsigned long long)totals[0], (unsigned long long)totals[1]);
+    assert(totals[2] == before[2] + 1 && totals[3] == before[3] + 300,
+           "Realloc sampled as a new allocation: %llu objects, %llu bytes\n", (unsigned long long)totals[2],
+           (unsigned long long)totals[3]);
+    release(char, 300, grown, allocator);
+    assert(profiler.sampler.live == 0, "Reallocated sample left in use\n");
+    profiler_destroy(&profiler);
+
+    // a profiled arena samples from its own allocation path, through its own allocator
+    assert(profiler_init_arena(&profiler, &arena, 1) == 0, "Cannot initialize the profiler\n");
+    allocator = arena_alloc_init(&arena);
+    for (int i = 0; i < NODES; i += 1)
+        nodes[i] = allocate_node(allocator);
+    grown = make(char, 100, allocator);
+    grown = resize(char, 300, 100, grown, allocator);
+    void *batch[BLOBS];
+    assert(arena_alloc_batch(BLOBS, 1000, batch, &arena) == BLOBS, "Cannot allocate the batch\n");
+    profile_totals(&profiler, totals);
+    assert(totals[0] == NODES + 1 + BLOBS && totals[1] == NODES * 64 + 300 + BLOBS * 1000,
+           "Unexpected in-use profile of the arena: %llu objects, %llu bytes\n", (unsigned long long)totals[0],
+           (unsigned long long)totals[1]);
+    assert(totals[2] == NODES + 1 + BLOBS, "Realloc of the arena sampled as a new allocation: %llu objects\n",
+           (unsigned long long)totals[2]);
+
+#if defined(__GLIBC__)
+    // the innermost frame is the allocation site, not the arena nor the profiler
+    found = 0;
+    for (size_t i = 0; i < profiler.stack_capacity; i += 1) {
+        ProfileStack *stack = profiler.stacks[i];
+        if (stack && stack->alloc_objects == NODES) {
+            found = stack->depth > 1 && stack->frames[1] == site_caller;
+        }
+    }
+    assert(found, "Allocation site not at the top of its stack in the arena\n");
+#endif
+
+    for (int i = 0; i < NODES; i += 1)
+        release(char, 64, nodes[i], allocator);
+    release(char, 300, grown, allocator);
+    arena_free_batch(BLOBS, 1000, batch, &arena);
+    profile_totals(&profiler, totals);
+    assert(totals[0] == 0 && totals[1] == 0 && profiler.sampler.live == 0, "Samples of the arena left in use\n");
+    profiler_destroy(&profiler);
+    assert(arena.sampler == NULL, "Arena still sampled after the profiler is destroyed\n");
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // at the default rate, about one allocation is sampled every PROFILE_DEFAULT_RATE bytes
+    assert(profiler_init(&profiler, arena_alloc_init(&arena), 0) == 0, "Cannot initialize the profiler\n");
+    allocator = profiler_alloc_init(&profiler);
+    for (int i = 0; i < ROUNDS; i += 1) {
+        char *block = make(char, ROUND_SIZE, allocator);
+        release(char, ROUND_SIZE, block, allocator);
+    }
+    profile_totals(&profiler, totals);
+    size_t expected_samples = (size_t)ROUNDS * ROUND_SIZE / PROFILE_DEFAULT_RATE;
+    assert(totals[2] > expected_samples / 2 && totals[2] < expected_samples * 2,
+           "Expected about %zu samples, got %llu\n", expected_samples, (unsigned long long)totals[2]);
+    assert(totals[0] == 0, "Samples left in use\n");
+    profiler_destroy(&profiler);
+
+    free(buffer);
+    buffer = NULL;
+
+    info("Profile test passed\n");
+
+    return 0;
+}
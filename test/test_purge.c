@@ -0,0 +1,114 @@
+#define _DEFAULT_SOURCE
+
+#include "../src/arena.h"
+#include "../src/utils.h"
+
+#include <memory.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define BLOCK_SIZE (512 * 1024)
+
+/**
+ * @brief Count the pages of a range resident in memory
+ *
+ * @param ptr start of the range, its first page is skipped if ptr is not page aligned
+ * @param size size of the range
+ * @return size_t number of resident pages
+ */
+static size_t resident_pages(void *ptr, size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)ptr + page - 1) & ~(uintptr_t)(page - 1);
+    uintptr_t end = ((uintptr_t)ptr + size) & ~(uintptr_t)(page - 1);
+    if (start >= end) {
+        return 0;
+    }
+
+    size_t count = (size_t)(end - start) / page;
+    unsigned char *pages = malloc(count);
+    if (!pages || mincore((void *)start, (size_t)(end - start), pages)) {
+        free(pages);
+        return (size_t)-1;
+    }
+    size_t resident = 0;
+    for (size_t i = 0; i < count; i += 1)
+        resident += pages[i] & 1;
+    free(pages);
+    return resident;
+}
+
+int main(void) {
+
+    Arena arena = arena_init_huge(16 * 1024 * 1024, DefaultPages, DEFAULT_ALLIGNMENT, BestFit);
+    assert(arena.base != NULL, "Cannot map the arena\n");
+    Allocator allocator = arena_alloc_init(&arena);
+
+    // the pages of a big free block are given back, its header stays
+    char *big = make(char, 4 * BLOCK_SIZE, allocator);
+    char *guard = make(char, 16, allocator);
+    memset(big, 'a', 4 * BLOCK_SIZE);
+    release(char, 4 * BLOCK_SIZE, big, allocator);
+    assert(resident_pages(big, 4 * BLOCK_SIZE) > 0, "Free block not resident before the purge\n");
+
+    size_t purged = arena_purge(&arena);
+    assert(purged > 0, "Nothing purged\n");
+    assert(resident_pages(big + sizeof(TreeBlock), 4 * BLOCK_SIZE - sizeof(TreeBlock)) == 0,
+           "Free block still resident after the purge\n");
+
+    char *reused = make(char, 4 * BLOCK_SIZE, allocator);
+    assert(reused == big, "Purged block not reused\n");
+    assert(reused[4 * BLOCK_SIZE - 1] == 0, "Purged memory not zero\n");
+    memset(reused, 'b', 4 * BLOCK_SIZE);
+
+    // above the offset, the purged pages are known to be zero again
+    char *top = make(char, 4 * BLOCK_SIZE, allocator);
+    memset(top, 'c', 4 * BLOCK_SIZE);
+    release(char, 4 * BLOCK_SIZE, top, allocator);
+    assert(arena.offset == (size_t)(top - (char *)arena.base), "Top block not rewound\n");
+
+    arena_purge(&arena);
+    assert(resident_pages(top, 4 * BLOCK_SIZE) == 0, "Top pages still resident after the purge\n");
+    assert(arena.zeroed <= arena.offset + (size_t)sysconf(_SC_PAGESIZE), "Zeroed mark not lowered: %zu\n",
+           arena.zeroed);
+
+    char *cleared = make_zeroed(char, 4 * BLOCK_SIZE, allocator);
+    for (size_t i = 0; i < 4 * BLOCK_SIZE; i += 1)
+        assert(cleared[i] == 0, "Memory not zero at %zu\n", i);
+    release(char, 4 * BLOCK_SIZE, cleared, allocator);
+    assert(reused[0] == 'b' && reused[4 * BLOCK_SIZE - 1] == 'b', "Memory in use purged\n");
+
+    release(char, 4 * BLOCK_SIZE, reused, allocator);
+    release(char, 16, guard, allocator);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // with a threshold, a block is purged only once it stayed free through a whole decay pass
+    arena_free_all(&arena);
+    arena_set_purge_threshold(&arena, BLOCK_SIZE);
+
+    char *first = make(char, BLOCK_SIZE, allocator);
+    char *first_guard = make(char, 16, allocator);
+    char *second = make(char, BLOCK_SIZE, allocator);
+    char *second_guard = make(char, 16, allocator);
+    memset(first, 'd', BLOCK_SIZE);
+    memset(second, 'e', BLOCK_SIZE);
+
+    release(char, BLOCK_SIZE, first, allocator);
+    assert(resident_pages(first + sizeof(TreeBlock), BLOCK_SIZE - sizeof(TreeBlock)) > 0,
+           "Block purged on its first pass\n");
+
+    release(char, BLOCK_SIZE, second, allocator);
+    assert(resident_pages(first + sizeof(TreeBlock), BLOCK_SIZE - sizeof(TreeBlock)) == 0,
+           "Old block not purged on the second pass\n");
+    assert(resident_pages(second + sizeof(TreeBlock), BLOCK_SIZE - sizeof(TreeBlock)) > 0,
+           "Young block purged on its first pass\n");
+
+    release(char, 16, second_guard, allocator);
+    release(char, 16, first_guard, allocator);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    arena_destroy(&arena);
+
+    info("Purge test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "../src/slab.h"
+#include "../src/utils.h"
+
+#define COUNT 400
+
+int main(void) {
+
+    size_t size = 1024 * 1024;
+    void *buffer = malloc(size);
+
+    Arena arena = arena_init(buffer, size, 8, BestFit);
+    SlabArena slab = slab_arena_init(&arena);
+    Allocator allocator = slab_arena_alloc_init(&slab);
+
+    // 8-byte blocks are packed without headers, a slab holds hundreds of them
+    void *small[COUNT];
+    for (int i = 0; i < COUNT; i += 1) {
+        small[i] = make(char, 8, allocator);
+        assert(small[i] != NULL, "Allocation %d failed\n", i);
+    }
+    assert((char *)small[1] == (char *)small[0] + 8, "Slots not packed\n");
+    assert(allocated(allocator) == COUNT * 8, "Unexpected allocated: %zu\n", allocated(allocator));
+
+    // frees too small for a free block of the arena are reused
+    for (int i = 0; i < COUNT; i += 2)
+        release(char, 8, small[i], allocator);
+    char *reused = make(char, 8, allocator);
+    assert(reused == small[0], "Freed 8-byte slot not reused\n");
+    small[0] = reused;
+
+    // each class has its own slabs, big requests go to the arena
+    int *medium = make(int, 10, allocator);
+    assert(((uintptr_t)medium & (SLAB_SIZE - 1)) == 0, "New class not given a new slab\n");
+    char *big = make(char, 1000, allocator);
+    assert(big != NULL, "Big allocation failed\n");
+
+    // moving out of a class copies the memory, staying in it keeps the slot
+    medium[0] = 42;
+    int *grown = resize(int, 9, 10, medium, allocator);
+    assert(grown == medium, "Slot not kept within its class\n");
+    grown = resize(int, 100, 9, grown, allocator);
+    assert(grown != medium && grown[0] == 42, "Memory not moved out of the slab\n");
+    release(int, 100, grown, allocator);
+
+    // aligned requests take the first free slot at an aligned address
+    char *aligned = make_aligned(char, 8, 64, allocator);
+    assert(((uintptr_t)aligned & 63) == 0, "Memory not aligned to 64 bytes: %p\n", (void *)aligned);
+    assert(aligned == small[8], "Free aligned slot not reused\n");
+    release(char, 8, aligned, allocator);
+
+    // batches take the free slots a bitmap word at a time
+    void *batch[100];
+    size_t carved = slab_arena_alloc_batch(100, 8, batch, &slab);
+    assert(carved == 100, "Expected 100 blocks, carved: %zu\n", carved);
+    slab_arena_free_batch(100, 8, batch, &slab);
+
+    release(char, 1000, big, allocator);
+    release(char, 8, small[0], allocator);
+    for (int i = 1; i < COUNT; i += 2)
+        release(char, 8, small[i], allocator);
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+
+    // only the last slab of each class stays in it, the other empty ones are kept aside for any class
+    size_t kept = 0;
+    for (size_t class = 0; class < SLAB_CLASSES; class += 1) {
+        for (Slab *s = slab.partial[class]; s; s = s->next) {
+            assert(s->used == 0, "Slot left in use in class %zu\n", class);
+            kept++;
+        }
+    }
+    assert(kept <= 3, "Empty slabs left in their class, kept: %zu\n", kept);
+
+    Slab *spare = slab.empty;
+    int *other = make(int, 12, allocator);
+    assert(!spare || (uintptr_t)other == ((uintptr_t)spare & ~(uintptr_t)(SLAB_SIZE - 1)), "Empty slab not reused\n");
+    release(int, 12, other, allocator);
+    slab_arena_trim(&slab);
+    assert(slab.empty == NULL, "Empty slabs not given back\n");
+
+    // like realloc, a size of zero frees the block
+    other = make(int, 12, allocator);
+    assert(resize(int, 0, 12, other, allocator) == NULL, "Block resized to zero still returned\n");
+    assert(allocated(allocator) == 0, "Block resized to zero not freed, allocated: %zu\n", allocated(allocator));
+
+    slab_arena_free_all(&slab);
+
+    free(buffer);
+    buffer = NULL;
+
+    info("Slab test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "../src/arena.h"
+#include "../src/utils.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define COUNT 10000
+
+typedef struct Node {
+    struct Node *next;
+    size_t value;
+} Node;
+
+/**
+ * @brief Sum the values of a list read through a snapshot
+ *
+ * @param snapshot snapshot to read
+ * @param head first node of the list, in the live heap
+ * @return size_t sum of the values
+ */
+static size_t snapshot_sum(ArenaSnapshot *snapshot, Node *head) {
+    size_t sum = 0;
+    for (const Node *node = arena_snapshot_ptr(snapshot, head); node; node = arena_snapshot_ptr(snapshot, node->next))
+        sum += node->value;
+    return sum;
+}
+
+int main(void) {
+
+    Arena arena = arena_init_shared(4 * 1024 * 1024, DEFAULT_ALLIGNMENT, BestFit);
+    assert(arena.base != NULL, "Cannot create a shared arena\n");
+    Allocator allocator = arena_alloc_init(&arena);
+
+    Node *head = NULL;
+    for (size_t i = 0; i < COUNT; i += 1) {
+        Node *node = make(Node, 1, allocator);
+        node->value = i;
+        node->next = head;
+        head = node;
+    }
+    size_t sum = (size_t)COUNT * (COUNT - 1) / 2;
+
+    ArenaSnapshot snapshot;
+    assert(arena_snapshot(&arena, &snapshot) == 0, "Cannot take a snapshot\n");
+    assert(snapshot.offset == arena.offset, "Unexpected snapshot offset: %zu\n", snapshot.offset);
+    ArenaSnapshot second;
+    assert(arena_snapshot(&arena, &second) == -1, "Second live snapshot taken\n");
+
+    // the live list keeps changing, the snapshot does not see it
+    for (Node *node = head; node; node = node->next)
+        node->value *= 2;
+    Node *extra = make(Node, 1, allocator);
+    extra->value = 1;
+    extra->next = head;
+    head = extra;
+
+    assert(snapshot_sum(&snapshot, head->next) == sum, "Snapshot changed, sum: %zu\n", snapshot_sum(&snapshot, head));
+    size_t live = 0;
+    for (Node *node = head; node; node = node->next)
+        live += node->value;
+    assert(live == 2 * sum + 1, "Unexpected live sum: %zu\n", live);
+
+    // a release that cannot write the pages back keeps the snapshot and the writes
+    int file = dup(arena.fd);
+    int read_only = open("/dev/null", O_RDONLY);
+    assert(file >= 0 && read_only >= 0 && dup2(read_only, arena.fd) == arena.fd, "Cannot swap the memory file\n");
+    assert(arena_snapshot_release(&snapshot) == -1, "Release without a write back succeeded\n");
+    assert(arena.snapshot == &snapshot, "Snapshot dropped by a failed release\n");
+    assert(snapshot_sum(&snapshot, head->next) == sum, "Snapshot changed by a failed release\n");
+    dup2(file, arena.fd);
+    close(file);
+    close(read_only);
+
+    live = 0;
+    for (Node *node = head; node; node = node->next)
+        live += node->value;
+    assert(live == 2 * sum + 1, "Writes lost on a failed release, sum: %zu\n", live);
+
+    // after the release the heap is shared again, with every write kept
+    assert(arena_snapshot_release(&snapshot) == 0, "Cannot release the snapshot\n");
+    assert(arena.snapshot == NULL, "Snapshot still live\n");
+
+    live = 0;
+    for (Node *node = head; node; node = node->next)
+        live += node->value;
+    assert(live == 2 * sum + 1, "Writes lost on release, sum: %zu\n", live);
+
+    assert(arena_snapshot(&arena, &snapshot) == 0, "Cannot take a snapshot again\n");
+    assert(snapshot_sum(&snapshot, head) == 2 * sum + 1, "Snapshot misses the written pages\n");
+    assert(arena_snapshot_release(&snapshot) == 0, "Cannot release the snapshot\n");
+
+    Arena plain = arena_init_virtual(1024 * 1024, 0, DEFAULT_ALLIGNMENT, BestFit);
+    assert(arena_snapshot(&plain, &snapshot) == -1, "Snapshot of an unshared arena taken\n");
+    arena_destroy(&plain);
+
+    // destroying the arena releases a snapshot still live
+    assert(arena_snapshot(&arena, &snapshot) == 0, "Cannot take a snapshot before destroying\n");
+    arena_destroy(&arena);
+    assert(snapshot.base == NULL && snapshot.arena == NULL, "Snapshot not released with its arena\n");
+
+    info("Snapshot test passed\n");
+
+    return 0;
+}
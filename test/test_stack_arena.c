@@ -0,0 +1,106 @@
+#include "../src/stack_arena.h"
+#include "../src/utils.h"
+
+#include <string.h>
+
+int main(void) {
+
+    size_t size = 64 * 1024;
+    void *buffer = malloc(size);
+
+    StackArena stack;
+    stack_arena_init(&stack, buffer, size, DEFAULT_ALLIGNMENT);
+    Allocator results = stack_arena_alloc_init(&stack, StackLow);
+    Allocator temps = stack_arena_alloc_init(&stack, StackHigh);
+
+    // results grow up from the start, temporaries down from the end, they never interleave
+    int *result = make(int, 100, results);
+    char *temp = make(char, 100, temps);
+    assert((uint8_t *)result == (uint8_t *)buffer + DEFAULT_ALLIGNMENT, "Low end not starting at the buffer\n");
+    assert((uintptr_t)temp % DEFAULT_ALLIGNMENT == 0, "High end memory not aligned: %p\n", (void *)temp);
+    assert((uint8_t *)temp + 100 + sizeof(size_t) <= (uint8_t *)buffer + size &&
+               (uint8_t *)temp + 100 + sizeof(size_t) + DEFAULT_ALLIGNMENT > (uint8_t *)buffer + size,
+           "High end not starting at the end of the buffer\n");
+
+    // LIFO frees pop each end back, padding included
+    char *temps_block[10];
+    for (int i = 0; i < 10; i += 1)
+        temps_block[i] = make(char, 1 + i * 7, temps);
+    for (int i = 9; i >= 0; i -= 1)
+        release(char, 1 + i * 7, temps_block[i], temps);
+    assert(stack_arena_mark(stack.sides + StackHigh) == (size_t)(temp - (char *)buffer),
+           "High end not popped back\n");
+    release(char, 100, temp, temps);
+    assert(allocated(temps) == 0, "High end not empty, allocated: %zu\n", allocated(temps));
+
+    // a block freed out of order stays until a mark below it is rewound
+    size_t below = stack_arena_mark(stack.sides + StackLow);
+    int *other = make(int, 3, results);
+    int *last = make(int, 5, results);
+    release(int, 3, other, results);
+    release(int, 5, last, results);
+    assert((char *)buffer + allocated(results) == (char *)(other + 3),
+           "Low end not popped back to the block freed out of order\n");
+    stack_arena_rewind(below, stack.sides + StackLow);
+    assert((char *)buffer + allocated(results) == (char *)(result + 100), "Low end not rewound, allocated: %zu\n",
+           allocated(results));
+
+    // the last block of an end is resized in place, on the high end its data slides down
+    result = resize(int, 200, 100, result, results);
+    assert((uint8_t *)result == (uint8_t *)buffer + DEFAULT_ALLIGNMENT, "Low end block not grown in place\n");
+
+    temp = make(char, 16, temps);
+    memcpy(temp, "stack arena", 12);
+    char *grown = resize(char, 64, 16, temp, temps);
+    assert(grown < temp && strcmp(grown, "stack arena") == 0, "High end block not grown down\n");
+    size_t grown_use = allocated(temps);
+    assert(grown_use == (size_t)((char *)buffer + size - grown), "Unexpected high end use: %zu\n", grown_use);
+
+    // a mark drops everything pushed after it at once
+    size_t mark = stack_arena_mark(stack.sides + StackHigh);
+    for (int i = 0; i < 100; i += 1)
+        make(double, 10, temps);
+    stack_arena_rewind(mark, stack.sides + StackHigh);
+    assert(allocated(temps) == grown_use, "High end not rewound to the mark: %zu\n", allocated(temps));
+
+    // the ends meet in the middle, neither can push past the other
+    void *fill = make(char, size - allocated(results) - allocated(temps) - DEFAULT_ALLIGNMENT, results);
+    assert(fill != NULL, "Memory between the ends not usable\n");
+    assert(make(char, 1, temps) == NULL && make(char, 1, results) == NULL, "Ends crossed each other\n");
+
+    double *aligned = make_aligned(double, 1, 64, temps);
+    assert(aligned == NULL, "Aligned push past the other end\n");
+
+    stack_arena_free_all(stack.sides + StackLow);
+    aligned = make_aligned(double, 1, 64, temps);
+    assert(((uintptr_t)aligned & 63) == 0, "Memory not aligned to 64 bytes: %p\n", (void *)aligned);
+    assert(allocated(results) == 0, "Low end not emptied, allocated: %zu\n", allocated(results));
+
+    stack_arena_free_all(stack.sides + StackHigh);
+    assert(allocated(temps) == 0, "High end not emptied, allocated: %zu\n", allocated(temps));
+
+    // blocks pushed plain, over-aligned and plain again pop back in LIFO order, the padding included
+    for (int end = StackLow; end <= StackHigh; end += 1) {
+        Allocator side = stack_arena_alloc_init(&stack, end);
+        char *plain = make(char, 8, side);
+        double *over = make_aligned(double, 1, 64, side);
+        char *top = make(char, 24, side);
+        assert(((uintptr_t)over & 63) == 0, "Memory not aligned to 64 bytes: %p\n", (void *)over);
+        release(char, 24, top, side);
+        release(double, 1, over, side);
+        release(char, 8, plain, side);
+        assert(allocated(side) == 0, "End %d not popped back, allocated: %zu\n", end, allocated(side));
+    }
+
+    // like realloc, a size of zero pops the last block
+    char *popped = make(char, 24, results);
+    assert(resize(char, 0, 24, popped, results) == NULL, "Block resized to zero still returned\n");
+    assert(allocated(results) == 0, "Block resized to zero not popped, allocated: %zu\n", allocated(results));
+
+    free(buffer);
+    buffer = NULL;
+
+    info("Stack arena test passed\n");
+
+    return 0;
+}
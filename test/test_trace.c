@@ -0,0 +1,92 @@
+#include "../src/arena.h"
+#include "../src/trace.h"
+#include "../src/utils.h"
+
+#define COUNT 2000
+#define TRACE_PATH "target/test/output/test_trace.bin"
+
+int main(void) {
+
+    size_t size = 1024 * 1024;
+    void *buffer = malloc(size);
+    Arena arena = arena_init(buffer, size, DEFAULT_ALLIGNMENT, BestFit);
+
+    TraceRecorder recorder;
+    assert(trace_recorder_init(&recorder, arena_alloc_init(&arena), TRACE_PATH) == 0, "Cannot open %s\n",
+           TRACE_PATH);
+    Allocator allocator = trace_alloc_init(&recorder);
+
+    // enough live pointers to grow the table of the recorder a few times
+    char *blocks[COUNT];
+    for (int i = 0; i < COUNT; i += 1) {
+        blocks[i] = make(char, 16 + i % 64, allocator);
+        assert(blocks[i] != NULL, "Allocation %d failed\n", i);
+    }
+    for (int i = 0; i < COUNT; i += 2) {
+        release(char, 16 + i % 64, blocks[i], allocator);
+    }
+
+    char *grown = resize(char, 4096, 16 + 1 % 64, blocks[1], allocator);
+    assert(grown != NULL, "Reallocation failed\n");
+    blocks[1] = grown;
+
+    int *zeroed = make_zeroed(int, 10, allocator);
+    double *aligned = make_aligned(double, 4, 64, allocator);
+    assert(zeroed != NULL && aligned != NULL, "Allocation failed\n");
+
+    release(double, 4, aligned, allocator);
+    release(int, 10, zeroed, allocator);
+    release(char, 4096, blocks[1], allocator);
+    for (int i = 3; i < COUNT; i += 2) {
+        release(char, 16 + i % 64, blocks[i], allocator);
+    }
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+    assert(recorder.count == 0, "Pointers left in the recorder: %zu\n", recorder.count);
+    assert(trace_recorder_close(&recorder) == 0, "Cannot flush %s\n", TRACE_PATH);
+
+    // the trace reads back in order, every free matching an allocation by id
+    TraceReader reader;
+    assert(trace_reader_open(&reader, TRACE_PATH) == 0, "Cannot read %s\n", TRACE_PATH);
+
+    size_t counts[TraceAllocAligned + 1] = {0};
+    size_t live = 0;
+    uint64_t time = 0;
+    TraceEvent event;
+    int status;
+    while ((status = trace_reader_next(&reader, &event)) == 1) {
+        assert(event.time >= time, "Time going backwards: %lu\n", (unsigned long)event.time);
+        time = event.time;
+        counts[event.op]++;
+
+        if (event.op == TraceFree) {
+            live--;
+        } else if (event.op != TraceRealloc) {
+            live++;
+        }
+
+        if (event.op == TraceRealloc) {
+            assert(event.id == 1 && event.size == 4096 && event.arg == 17, "Unexpected realloc of %lu\n",
+                   (unsigned long)event.id);
+        }
+        if (event.op == TraceAllocAligned) {
+            assert(event.size == 32 && event.arg == 64, "Unexpected aligned allocation of %lu bytes\n",
+                   (unsigned long)event.size);
+        }
+    }
+    trace_reader_close(&reader);
+
+    assert(status == 0, "Trace truncated\n");
+    assert(counts[TraceAlloc] == COUNT, "Expected %d allocations, got: %zu\n", COUNT, counts[TraceAlloc]);
+    assert(counts[TraceFree] == COUNT + 2, "Expected %d frees, got: %zu\n", COUNT + 2, counts[TraceFree]);
+    assert(counts[TraceRealloc] == 1, "Expected 1 reallocation, got: %zu\n", counts[TraceRealloc]);
+    assert(counts[TraceCalloc] == 1, "Expected 1 zeroed allocation, got: %zu\n", counts[TraceCalloc]);
+    assert(counts[TraceAllocAligned] == 1, "Expected 1 aligned allocation, got: %zu\n", counts[TraceAllocAligned]);
+    assert(live == 0, "Unbalanced trace, live: %zu\n", live);
+
+    free(buffer);
+    buffer = NULL;
+
+    info("Trace test passed\n");
+
+    return 0;
+}
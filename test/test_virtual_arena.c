@@ -0,0 +1,58 @@
+#include "../src/arena.h"
+#include "../src/utils.h"
+
+#include <string.h>
+
+int main(void) {
+
+    size_t reserve = (size_t)1 << 36; // 64 GiB, nothing is committed up front
+    size_t chunk = 1024 * 1024;
+
+    Arena arena = arena_init_virtual(reserve, chunk, DEFAULT_ALLIGNMENT, BestFit);
+    assert(arena.base != NULL, "Failed to reserve %zu bytes\n", reserve);
+    assert(arena.backing == VirtualBacking, "Unexpected backing: %d\n", arena.backing);
+    assert(arena.mapped == 0, "Memory committed up front: %zu\n", arena.mapped);
+
+    Allocator allocator = arena_alloc_init(&arena);
+
+    char *small = make(char, 100, allocator);
+    memset(small, 'a', 100);
+    assert(arena.mapped == chunk, "Expected a single chunk committed, committed: %zu\n", arena.mapped);
+
+    // growing past the committed memory commits the next chunks, pointers stay stable
+    char *blocks[8];
+    for (int i = 0; i < 8; i += 1) {
+        blocks[i] = make(char, chunk, allocator);
+        assert(blocks[i] != NULL, "Failed to allocate block %d\n", i);
+        memset(blocks[i], 'b' + i, chunk);
+    }
+    assert(arena.mapped >= arena.offset, "Offset past committed memory: %zu > %zu\n", arena.offset, arena.mapped);
+    assert(arena.mapped < arena.offset + chunk, "Committed too much memory: %zu\n", arena.mapped);
+
+    for (int i = 0; i < 100; i += 1)
+        assert(small[i] == 'a', "Memory moved at %d\n", i);
+
+    for (int i = 7; i >= 0; i -= 1)
+        release(char, chunk, blocks[i], allocator);
+    release(char, 100, small, allocator);
+
+    assert(allocated(allocator) == 0, "Memory leak detected, allocated: %zu\n", allocated(allocator));
+    assert(arena.offset == 0, "Offset not rewound, offset: %zu\n", arena.offset);
+
+    // zeroed memory is only cleared below the highest offset reached, the rest is still zero from the kernel
+    size_t dirty = arena.zeroed;
+    assert(dirty >= 8 * chunk, "Touched memory not tracked, zeroed from: %zu\n", dirty);
+
+    int *table = make_zeroed(int, 4 * chunk, allocator);
+    for (size_t i = 0; i < 4 * chunk; i += 1)
+        assert(table[i] == 0, "Memory not zeroed at %zu\n", i);
+    release(int, 4 * chunk, table, allocator);
+    assert(arena.zeroed == 16 * chunk, "Mark not moved past the table, zeroed from: %zu\n", arena.zeroed);
+
+    arena_destroy(&arena);
+    assert(arena.base == NULL, "Arena not destroyed\n");
+
+    info("Virtual arena test passed\n");
+
+    return 0;
+}